@@ -0,0 +1,94 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "common/TOP_Data.hpp"
+#include "backTracking/TOP_Backtracking.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+/*
+
+Test of the pruning of the backtracking: the knapsack bound, the ellipse bound, the transposition table and
+the symmetry of the cars must only skip subtrees that cannot improve the best solution, so a complete search
+finds the same best profit with every switch on or off, serial or parallel.
+The instances are the ones passed as arguments or the ones in "instances" with at most MAX_POINTS points.
+
+*/
+
+#define MAX_POINTS 40
+#define N_SWITCHES 5 // Knapsack bound, ellipse bound, table, symmetry, parallel
+#define N_THREADS 4
+
+#define W_PROFIT 1.1
+#define W_TIME 0.7
+#define MAX_DEVIATION 1.5
+#define W_NON_COST 0.0
+
+/**
+ * Best profit of a complete search with the switches on in mask (bit 0 knapsack bound, bit 1 ellipse bound,
+ * bit 2 transposition table, bit 3 symmetry of the cars, bit 4 parallel)
+ */
+int Search(const TOP_Input& in, int mask) {
+  TOP_Walker tw(in, W_PROFIT, W_TIME, MAX_DEVIATION, W_NON_COST, 0, 0, mask & 8);
+  TOP_Checker ck;
+  ck.ClearBounds();
+  if(mask & 1) {
+    ck.AddBound(make_unique<TOP_KnapsackBound>());
+  }
+  if(mask & 2) {
+    ck.AddBound(make_unique<TOP_EllipseBound>());
+  }
+  if(!(mask & 4)) {
+    ck.Table().SetMemory(0);
+  }
+  if(mask & 16) {
+    ParallelBacktrack(tw, ck, INFINITY, N_THREADS);
+  }
+  else {
+    Backtrack(tw, ck, INFINITY);
+  }
+  return -ck.GetBestCost();
+}
+
+int main(int argc, char* argv[]) {
+  vector<fs::path> files(argv + 1, argv + argc);
+  if(files.empty()) {
+    for(const auto& file : fs::directory_iterator("./instances")) {
+      files.push_back(file.path());
+    }
+  }
+
+  int tested = 0, errors = 0;
+  for(const auto& file : files) {
+    TOP_Input in;
+    {
+      ifstream ifs(file);
+      if(!ifs) {
+        throw runtime_error("Unable to open file " + file.string());
+      }
+      ifs >> in;
+    }
+    if(argc == 1 && in.Points() > MAX_POINTS) {
+      continue;
+    }
+
+    int reference = Search(in, 0);
+    cout << file.filename().string() << ": " << reference << flush;
+    for(int mask = 1; mask < (1 << N_SWITCHES); ++mask) {
+      int profit = Search(in, mask);
+      if(profit != reference) {
+        ++errors;
+        cout << endl << "  ERROR: switches " << mask << " profit " << profit;
+      }
+    }
+    cout << endl;
+    ++tested;
+  }
+
+  cout << "Instances: " << tested << " | Errors: " << errors << endl;
+  return errors == 0 ? 0 : 1;
+}
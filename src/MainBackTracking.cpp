@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "backTracking/TOP_Backtracking.hpp"
+#include "common/TOP_Binary.hpp"
 #include "greedy/GreedyPaths.hpp"
 
 using namespace std;
@@ -32,6 +33,8 @@ struct chaoResults {
  *    paramTimeBt.txt : file in which are contained tthe max time permitted to execute the backtracking algorithm
  *                      on each instance, expressed in second.
  *                      Mandatory info: time for each instance. If not provided, default at 3 minutes.
+ *                      Optional info: "threads" number of threads of the search (default all the hardware threads)
+ *                      and "splitDepth" depth at which the tree is split among the threads.
  *                      The file is located in "parametes_in" directory.
  * 
  *    chaoResults.txt : file in which are contained Chao's results, used to compare greedy scores whith Chao's ones.
@@ -65,6 +68,7 @@ struct chaoResults {
 int main(int argc, char* argv[]) {
 
   double maxTime = 3.0 * 60.0; //  Default Time limit: 3 minutes
+  int nThreads = 0, splitDepth = BACKTRACK_SPLIT_DEPTH; // Default all the hardware threads
   int errors = 0, cnt_istances =  0;
   bool timeDefault = false;
   vector<chaoResults> chaoRes;
@@ -89,6 +93,12 @@ int main(int argc, char* argv[]) {
       if (results[0] == "timeMax") {
         maxTime = stod(results[1]);
       }
+      else if (results[0] == "threads") {
+        nThreads = stoi(results[1]);
+      }
+      else if (results[0] == "splitDepth") {
+        splitDepth = stoi(results[1]);
+      }
       else {
         continue;
       }
@@ -144,13 +154,11 @@ int main(int argc, char* argv[]) {
 
     cerr << "Processing: " << file.path().filename() << endl;
     {
-      ifstream is(file.path());
-      if (!is) {
+      if (!LoadInput(file.path().string(), in)) {
         ++errors;
         cerr << "  ERROR: Unable to open Instance file" << endl;
         continue;
       }
-      is >> in;
       in.name = file.path().filename().replace_extension("").string();
     }
 
@@ -193,7 +201,7 @@ int main(int argc, char* argv[]) {
     cerr << "LOG: param <" << wProfit << "; " << wTime << "; " << maxDeviation << "; " << wNonCost << ">" << endl; 
     TOP_Walker tw(in, wProfit, wTime, maxDeviation, wNonCost, 0);
     TOP_Checker ck;
-    Backtrack(tw, ck, maxTime);
+    ParallelBacktrack(tw, ck, maxTime, nThreads, splitDepth);
     
     { // Print the output
       string titleDir = "outputs/backtracking/#";
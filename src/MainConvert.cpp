@@ -0,0 +1,89 @@
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <map>
+
+#include "common/TOP_Data.hpp"
+#include "common/TOP_Binary.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+/**
+ * MainConvert.cpp is a main that converts the instances and the solutions from the text format to the binary
+ * one (see TOP_Binary.hpp), the binary files are saved next to the text ones and they are used by LoadInput and
+ * LoadOutput instead of parsing the text (until the text is modified).
+ *
+ * Input file:
+ *    "instances" files : files that contain the instances to convert.
+ *                        The files are located in "instances" directory.
+ *
+ *    "outputs" files : files (.out) that contain the solutions in hops form to convert, the instance of each
+ *                      solution is found by its name. The files are searched in all the "outputs" tree.
+ *
+ * Output files:
+ *    "instances/[name].topb" files : binary instances (with the distance table unless nodist is specified).
+ *
+ *    "outputs/.../[name].outb" files : binary solutions.
+ *
+ * Usage:
+ *    ./MainConvert.exe [nodist]
+ *    - nodist : do not save the distance tables
+ *
+ * @param argc number of items in the command line
+ * @param argv items in the command line
+ * @return convert all the files and print the number of errors
+ */
+int main(int argc, const char* argv[]) {
+  int errors = 0, cnt_instances = 0, cnt_outputs = 0;
+  bool withDistances = !(argc > 1 && string(argv[1]) == "nodist");
+  map<string, TOP_Input> ins;
+
+  for(const auto& file : fs::directory_iterator("./instances")) { // For each instance
+    if(file.path().extension() != ".txt")
+      continue;
+    auto name = file.path().filename().replace_extension("").string();
+    TOP_Input& in = ins[name];
+    {
+      ifstream is(file.path());
+      if(!is) {
+        ++errors;
+        cerr << "  ERROR: Unable to open Instance file " << file.path() << endl;
+        ins.erase(name);
+        continue;
+      }
+      is >> in;
+      in.name = name;
+    }
+    WriteBinary(fs::path(file.path()).replace_extension(TOP_BINARY_INPUT_EXT).string(), in, withDistances);
+    ++cnt_instances;
+  }
+
+  if(fs::exists("./outputs")) {
+    for(const auto& file : fs::recursive_directory_iterator("./outputs")) { // For each solution
+      if(!file.is_regular_file() || file.path().extension() != ".out")
+        continue;
+      auto name = file.path().filename().replace_extension("").string();
+      auto inIt = ins.find(name);
+      if(inIt == ins.end()) {
+        cerr << "  WARNING: No instance for " << file.path() << endl;
+        continue;
+      }
+      TOP_Output out(inIt->second);
+      {
+        ifstream is(file.path());
+        if(!is) {
+          ++errors;
+          cerr << "  ERROR: Unable to open Output file " << file.path() << endl;
+          continue;
+        }
+        is >> out;
+      }
+      WriteBinary(fs::path(file.path()).replace_extension(TOP_BINARY_OUTPUT_EXT).string(), out);
+      ++cnt_outputs;
+    }
+  }
+
+  cerr << "Converted " << cnt_instances << " instances and " << cnt_outputs << " solutions (" << errors << " errors)" << endl;
+  return errors;
+}
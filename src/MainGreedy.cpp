@@ -1,4 +1,5 @@
 #include "common/TOP_Data.hpp"
+#include "common/TOP_Binary.hpp"
 #include "greedy/TOP_Greedy.hpp"
 #include "common/Utils.hpp"
 
@@ -186,105 +187,88 @@ int main(int argc, char *argv[]) {
 
     cerr << "Processing: " << file.path().filename() << endl; 
     {
-      ifstream is(file.path());
-      if (!is) {
+      if (!LoadInput(file.path().string(), in)) {
         ++errors;
         cerr << "  ERROR: Unable to open Instance file" << endl;
         continue;
       }
-      is >> in;
       in.name = file.path().filename().replace_extension("").string();
     }
 
-    TOP_Output out(in);
-    
-    // Solve all the instances with the set of parameters and print the outputs
+    // Solve the instance with the set of parameters, the runs are solved together by the workers
+    vector<GreedyJob> jobs;
     for (double wTime = from_wTime; wTime <= to_wTime; wTime += up_wTime) {
       for(double maxDeviation = from_maxDeviation; maxDeviation <= to_maxDeviation; maxDeviation += up_maxDeviation) {
         for(double wNonCost = from_wNonCost; wNonCost <= to_wNonCost; wNonCost += up_wNonCost) {
-           
-          // cerr << "LOG: Solving with parmeters <wProfit: " << wProfit <<
-          //         ", wProfit: " << wTime << 
-          //         ", maxDeviation: " << maxDeviation << 
-          //         ", wNonCost: " << wNonCost << ">" << endl;
-          
-          // Double range parameters
-          // if(wProfit == 1.6) {
-          //   wProfit = 3.5;
-          //   to_wProfit = 3.7;
-          //   up_wProfit = 0.2;
-          // }
-          // if(wTime == 1.2) {
-          //   wTime = 2.9;
-          //   to_wTime = 3.7;
-          //   up_wTime = 0.5;
-          // }
-          // if(wNonCost == 1.2) {
-          //   wNonCost = 5.0;
-          //   to_wNonCost = 5.1;
-          //   up_wNonCost = 0.5;
-          // }
-
-          out.Clear();
-          GreedySolver(in, out, rng, from_wProfit, wTime, maxDeviation, wNonCost);
+          jobs.push_back({ &in, from_wProfit, wTime, maxDeviation, wNonCost, rng() });
+        }
+      }
+    }
 
-          if (out.PointProfit() > best) {
-            best = out.PointProfit();
-            if (!out.Feasible()) {
-              cerr << "  Invalid solution" << endl;
-              cout << file.path().filename() << ',' << -1 << endl;
-            }
-            else {
-              cerr << "  Solution found: " << out.PointProfit() << endl;
-              cout << file.path().filename() << ',' << out.PointProfit() << endl;
-            }
+    TOP_Output out(in);
+    size_t bestJob = jobs.size();
+    GreedyBatch(jobs, [&out, &best, &bestJob](size_t job, const TOP_Output& jobOut) {
+      // Same choice of the sequential loop: the first run (in parameter order) with the highest profit
+      if (jobOut.PointProfit() > best || (jobOut.PointProfit() == best && best > 0 && job < bestJob)) {
+        best = jobOut.PointProfit();
+        bestJob = job;
+        out = jobOut;
+      }
+    });
 
-            { // Print the outputs on file
+    if (bestJob < jobs.size()) { // Print the outputs of the best run
+      const GreedyJob& params = jobs[bestJob];
+      if (!out.Feasible()) {
+        cerr << "  Invalid solution" << endl;
+        cout << file.path().filename() << ',' << -1 << endl;
+      }
+      else {
+        cerr << "  Solution found: " << out.PointProfit() << endl;
+        cout << file.path().filename() << ',' << out.PointProfit() << endl;
+      }
 
-              string titleDir = "outputs/greedy/outGreedy/#";
-              titleDir.push_back(*argv[1]);
-              fs::create_directories(titleDir);
-              ofstream os(titleDir / file.path().filename().replace_extension(".out"));
-              if (!os) {
-                ++errors;
-                cerr << "  ERROR: Unable to open output file" << endl;
-                continue;
-              }
-              os << in << out;
-            }
+      { // Print the outputs on file
+        string titleDir = "outputs/greedy/outGreedy/#";
+        titleDir.push_back(*argv[1]);
+        fs::create_directories(titleDir);
+        ofstream os(titleDir / file.path().filename().replace_extension(".out"));
+        if (!os) {
+          ++errors;
+          cerr << "  ERROR: Unable to open output file" << endl;
+          continue;
+        }
+        os << in << out;
+      }
 
-            { // Print the Hops as outputs on file
-              string titleDir = "outputs/routeHops/greedy/#";
-              titleDir.push_back(*argv[1]);
-              fs::create_directories(titleDir);
-              ofstream os(titleDir / file.path().filename().replace_extension(".out"));
-              if (!os) {
-                ++errors;
-                cerr << "  ERROR: Unable to open output file" << endl;
-                continue;
-              }
-              os << out;
-            }
+      { // Print the Hops as outputs on file
+        string titleDir = "outputs/routeHops/greedy/#";
+        titleDir.push_back(*argv[1]);
+        fs::create_directories(titleDir);
+        ofstream os(titleDir / file.path().filename().replace_extension(".out"));
+        if (!os) {
+          ++errors;
+          cerr << "  ERROR: Unable to open output file" << endl;
+          continue;
+        }
+        os << out;
+      }
 
-            { // Print the parameters of optimum on file
-              ofstream os(GetGreedyBestParamsPath(in.name));
-              if (!os) {
-                ++errors;
-                cerr << "  ERROR: Unable to open output file" << endl;
-                continue;
-              }
-              os << "Profit found: " << out.PointProfit() << endl;
-              os << "Param wProfit: " << from_wProfit << endl;
-              os << "Param wTime: " << wTime << endl;
-              os << "Param maxDeviation: " << maxDeviation << endl;
-              os << "Param wNonCost: " << wNonCost << endl;
-            } 
-          }
+      { // Print the parameters of optimum on file
+        ofstream os(GetGreedyBestParamsPath(in.name));
+        if (!os) {
+          ++errors;
+          cerr << "  ERROR: Unable to open output file" << endl;
+          continue;
         }
-      }            
+        os << "Profit found: " << out.PointProfit() << endl;
+        os << "Param wProfit: " << params.wProfit << endl;
+        os << "Param wTime: " << params.wTime << endl;
+        os << "Param maxDeviation: " << params.maxDeviation << endl;
+        os << "Param wNonCost: " << params.wNonCost << endl;
+      }
     }
         
-    if(out.PointProfit() == 0) { // No solution found, the problem is unfeasible
+    if(best == 0) { // No solution found, the problem is unfeasible
       { // Print the outputs on file
         string titleDir = "outputs/greedy/outGreedy/#";
         titleDir.push_back(*argv[1]);
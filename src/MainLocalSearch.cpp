@@ -1,6 +1,7 @@
 #include "localSearch/TOP_Helpers.hpp"
 #include "localSearch/TOP_Costs.hpp"
 #include "localSearch/Moves/Swap.hpp"
+#include "common/TOP_Binary.hpp"
 
 #include <fstream>
 #include <algorithm>
@@ -117,25 +118,21 @@ int main(int argc, const char* argv[])
 
     std::cerr << "Processing: " << file.path().filename() << std::endl; 
     {
-      ifstream is(file.path());
-      if (!is) {
+      if (!LoadInput(file.path().string(), in)) {
         ++errors;
         std::cerr << "  ERROR: Unable to open Instance file" << std::endl;
         continue;
       }
-      is >> in;
       in.name = file.path().filename().replace_extension("").string();
     }
     
     TOP_Output out_prec(in);
     {
-      ifstream is("./outputs/routeHops/bestRoutes/" + routeB + "/" + in.name + ".out");
-      if (!is) {
+      if (!LoadOutput("./outputs/routeHops/bestRoutes/" + routeB + "/" + in.name + ".out", out_prec)) {
         ++errors;
         std::cerr << "  ERROR: Unable to open bestRoutes Instance file" << std::endl;
         continue;
       }
-      is >> out_prec;
     }
     double precProfit = out_prec.PointProfit();
 
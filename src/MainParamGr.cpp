@@ -101,7 +101,6 @@ int main(int argc, char *argv[]) {
   vector<double> res;
   int errors = 0;
   double cnt_istances = 0.0;
-  TOP_Input in;
   string line;
 
   if (argc < 9) {
@@ -178,7 +177,48 @@ int main(int argc, char *argv[]) {
     std::cerr << "LOG: Processing map  " << *argv[1] << endl;
   }  
 
+  vector<TOP_Input> inputs(chao.size()); // Loaded once, solved for every parameter
+  for(idx_t idx = 0; idx < chao.size(); ++idx) { // For every file in chao vector
+    ifstream is("./Instances/" + chao[idx].file);
+    if (!is) {
+      ++errors;
+      throw runtime_error("  ERROR: Unable to open Instance file");
+      // continue;
+    }
+    is >> inputs[idx];
+  }
+
+  // All the runs (every parameter on every instance) are solved together by the workers
+  vector<double> params;
+  vector<GreedyJob> jobs;
   for(double paramChose = from; paramChose <= to; paramChose += over) { // For every parameter
+    params.push_back(paramChose);
+    for(idx_t idx = 0; idx < chao.size(); ++idx) {
+      if((string)argv[2] == "wProfit") {
+        jobs.push_back({ &inputs[idx], paramChose, param1, param2, param3, rng() });
+      }
+      else if ((string)argv[2] == "wTime") {
+        jobs.push_back({ &inputs[idx], param1, paramChose, param2, param3, rng() });
+      }
+      else if((string)argv[2] == "maxDeviation") {
+        jobs.push_back({ &inputs[idx], param1, param2, paramChose, param3, rng() });
+      }
+      else if((string)argv[2] == "wNonCost") {
+        jobs.push_back({ &inputs[idx], param1, param2, param3, paramChose, rng() });
+      }
+    }
+  }
+  if(jobs.size() != params.size() * chao.size()) {
+    throw runtime_error("  ERROR: Unknown parameter " + (string)argv[2]);
+  }
+
+  vector<double> profits(jobs.size());
+  GreedyBatch(jobs, [&profits](size_t job, const TOP_Output& out) {
+    profits[job] = out.PointProfit();
+  });
+
+  for(size_t paramIdx = 0; paramIdx < params.size(); ++paramIdx) { // For every parameter
+    double paramChose = params[paramIdx];
     
     std::cerr << "LOG: Processing param <" << (string)argv[2] << ": " << paramChose << "> ";
 
@@ -197,34 +237,7 @@ int main(int argc, char *argv[]) {
 
     res.clear();
     for(idx_t idx = 0; idx < chao.size(); ++idx) { // For every file in chao vector
-      //cout << "Processing: " << chao[idx].file << endl;
-      {
-        ifstream is("./Instances/" + chao[idx].file);
-        if (!is) {
-          ++errors;
-          throw runtime_error("  ERROR: Unable to open Instance file");
-          // continue;
-        }
-        is >> in;
-      }
-
-      TOP_Output out(in); // Solve the greedy and print the results for python plot 
-      out.Clear();
-
-      if((string)argv[2] == "wProfit") {
-        GreedySolver(in, out, rng, paramChose, param1, param2, param3);
-      }
-      else if ((string)argv[2] == "wTime") {
-        GreedySolver(in, out, rng, param1, paramChose, param2, param3);
-      }
-      else if((string)argv[2] == "maxDeviation") {
-        GreedySolver(in, out, rng, param1, param2, paramChose, param3);
-      }
-      else if((string)argv[2] == "wNonCost") {
-       GreedySolver(in, out, rng, param1, param2, param3, paramChose);
-      }
-
-      res.push_back(out.PointProfit() / chao[idx].chaoOptimum * 100); //Normalized the solution found
+      res.push_back(profits[paramIdx * chao.size() + idx] / chao[idx].chaoOptimum * 100); //Normalized the solution found
     }
 
     double sumSol = 0.0;
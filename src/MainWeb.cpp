@@ -1,4 +1,5 @@
 #include "common/TOP_Data.hpp"
+#include "common/TOP_Binary.hpp"
 #include "common/Utils.hpp"
 #include "common/JsonUtils.hpp"
 
@@ -49,6 +50,7 @@ const std::map<std::string, std::string> mimes = {
 const std::vector<AbstractWebSolver*> solvers = {
   new WebSolverGreedy(),
   new WebSolverGreedyRange(),
+  new WebSolverGreedyAdaptive(),
   new WebSolverBackTracking(),
   new WebSolverBackTrackingFocus(),
   new WebSolverLocalSA(),
@@ -152,12 +154,10 @@ class HSR_SolverPlus : public hs::http_resource {
 
       TOP_Input in;
       {
-        std::ifstream is(inst);
-        if(!is) {
+        if(!LoadInput(inst.string(), in)) {
           std::cerr << "ERROR: Unable to open instance" << std::endl;
           return http_resp_ptr(new hs::string_response("Unable to open instance", hs_utils::http_internal_server_error));
         }
-        is >> in;
         in.name = inst.filename().replace_extension("").string();
       }
 
@@ -24,6 +24,7 @@ namespace fs = std::filesystem;
 #include "common/JsonUtils.hpp"
 
 #include "common/TOP_Data.hpp"
+#include "common/TOP_Binary.hpp"
 #include "web/SolverLocal.hpp"
 #include "web/SolverGreedy.hpp"
 #include "web/SolverBacktracking.hpp"
@@ -50,6 +51,9 @@ void runThread(int id, const TOP_Input& in, lockflush& lf, std::string algo, std
   } else if(algo == "GREEDY RANGE") {
     WebSolverGreedyRange greedyRange;
     greedyRange.Solve(in, out, rng, options, nullStream);
+  } else if(algo == "GREEDY ADAPTIVE") {
+    WebSolverGreedyAdaptive greedyAdaptive;
+    greedyAdaptive.Solve(in, out, rng, options, nullStream);
   } else if(algo == "BT") {
     WebSolverBackTracking bt;
     bt.Solve(in, out, rng, options, nullStream);
@@ -127,12 +131,8 @@ int main(int argc, const char* argv[]) {
     auto name = file.path().filename().replace_extension("").string();
     ins[name] = TOP_Input {};
     ins[name].name = name;
-    {
-      ifstream ifs(file.path());
-      if(!ifs) {
-        throw new runtime_error("Unable to open file");
-      }
-      ifs >> ins[name];
+    if(!LoadInput(file.path().string(), ins[name])) {
+      throw new runtime_error("Unable to open file");
     }
   }
 
@@ -6,11 +6,10 @@
 #include <set>
 
 #include <thread>
-#include <shared_mutex>
-#include <ctpl_stl.h>
 
 #include "common/Utils.hpp"
 #include "common/TOP_Data.hpp"
+#include "common/ParamSearch.hpp"
 #include "greedy/TOP_Greedy.hpp"
 
 using namespace std;
@@ -90,152 +89,16 @@ In alterantiva si può porre che fino a una certa depth viene sempre eseguito il
 
 */
 
-typedef int sq_vals_t[2][2]; // Profitto degli angoli (check semplice, potrebbe essere accompagnato da checksum soluzione, non assicura confronto corretto)
-// A B     A
-//     -> B C
-// C D     D
-struct pos_t {
-  int wTimeIdx;
-  int maxDevIdx;
-};
-bool operator<(const pos_t& a, const pos_t& b) {
-  return a.wTimeIdx < b.wTimeIdx || (a.wTimeIdx == b.wTimeIdx &&
-    a.maxDevIdx < b.maxDevIdx
-  );
-}
+// The refinement is implemented in general by ParamSearch (common/ParamSearch.hpp)
 
 #define MIN_DEPTH 5
 #define MAX_DEPTH 8
 
-// Se depth 1 (primo thread, depth 0 calcola gli angoli) allora gli sq hanno indici sono in 0 e 2^MAX_DEPTH e pos risulta 2^(MAX_DEPTH-1)
-// Se N allora partendo da 0 ottengo 2^(MAX_DEPTH-N+1) come spigoli e pos di 2^(MAX_DEPTH-N)
-// Quindi il raggio è tale da avere al passo successivo POS +- 2^(MAX_DEPTH-N-1)
-// Ovviamente 2^X = 1 << X
-// Fissa il seed per avere una soluzione stabile a blocchi
-
-double wTimeFromIdx(int wTimeIdx) {
-  return WT_MIN + wTimeIdx * (WT_MAX - WT_MIN) / (1 << MAX_DEPTH);
-}
-
-double maxDevFromIdx(int maxDevIdx) {
-  return MDEV_MIN + maxDevIdx * (MDEV_MAX - MDEV_MIN) / (1 << MAX_DEPTH);
-}
-
-void runThread(int id, ctpl::thread_pool& pool, const TOP_Input& in, mt19937::result_type seed, safe_map<pos_t, int>& profits, sq_vals_t sq_vals, pos_t pos, int depth) {
-  // Calcola in O
-  int oProfit = -1;
-  {
-    mt19937 rng(seed);
-    TOP_Output out(in);
-    GreedySolver(in, out, rng, 1.0, wTimeFromIdx(pos.wTimeIdx), maxDevFromIdx(pos.maxDevIdx), 0);
-    oProfit = out.PointProfit();
-  }
-
-  // Agguingi al map
-  profits.insert(pos, oProfit);
-
-  sq_vals_t dots = { {-1, -1}, {-1, -1} };
-
-  // Inferisci i ., prendili dal map o calcolali
-
-  pos_t top { .wTimeIdx = pos.wTimeIdx, .maxDevIdx = pos.maxDevIdx - (1 << (MAX_DEPTH - depth)) };
-  pos_t left { .wTimeIdx = pos.wTimeIdx - (1 << (MAX_DEPTH - depth)), .maxDevIdx = pos.maxDevIdx };
-  pos_t right { .wTimeIdx = pos.wTimeIdx + (1 << (MAX_DEPTH - depth)), .maxDevIdx = pos.maxDevIdx };
-  pos_t bottom { .wTimeIdx = pos.wTimeIdx, .maxDevIdx = pos.maxDevIdx + (1 << (MAX_DEPTH - depth)) };
-
-  if(sq_vals[0][0] == oProfit || sq_vals[0][1] == oProfit) {
-    dots[0][0] = oProfit;
-    profits.insert(top, dots[0][0]);
-  } else if(!profits.find(top, dots[0][0])) {
-    {
-      mt19937 rng(seed);
-      TOP_Output out(in);
-      GreedySolver(in, out, rng, 1.0, wTimeFromIdx(top.wTimeIdx), maxDevFromIdx(top.maxDevIdx), 0);
-      dots[0][0] = out.PointProfit();
-    }
-    profits.insert(top, dots[0][0]);
-  }
-  if(sq_vals[0][0] == oProfit || sq_vals[1][0] == oProfit) {
-    dots[0][1] = oProfit;
-    profits.insert(left, dots[0][1]);
-  } else if(!profits.find(left, dots[0][1])) {
-    {
-      mt19937 rng(seed);
-      TOP_Output out(in);
-      GreedySolver(in, out, rng, 1.0, wTimeFromIdx(left.wTimeIdx), maxDevFromIdx(left.maxDevIdx), 0);
-      dots[0][1] = out.PointProfit();
-    }
-    profits.insert(left, dots[0][1]);
-  }
-  if(sq_vals[0][1] == oProfit || sq_vals[1][1] == oProfit) {
-    dots[1][0] = oProfit;
-    profits.insert(right, dots[1][0]);
-  } else if(!profits.find(right, dots[1][0])) {
-    {
-      mt19937 rng(seed);
-      TOP_Output out(in);
-      GreedySolver(in, out, rng, 1.0, wTimeFromIdx(right.wTimeIdx), maxDevFromIdx(right.maxDevIdx), 0);
-      dots[1][0] = out.PointProfit();
-    }
-    profits.insert(right, dots[1][0]);
-  }
-  if(sq_vals[1][0] == oProfit || sq_vals[1][1] == oProfit) {
-    dots[1][1] = oProfit;
-    profits.insert(bottom, dots[1][1]);
-  } else if(!profits.find(bottom, dots[1][1])) {
-    {
-      mt19937 rng(seed);
-      TOP_Output out(in);
-      GreedySolver(in, out, rng, 1.0, wTimeFromIdx(bottom.wTimeIdx), maxDevFromIdx(bottom.maxDevIdx), 0);
-      dots[1][1] = out.PointProfit();
-    }
-    profits.insert(bottom, dots[1][1]);
-  }
-
-  // Ora vedi quali quadranti calcolare in modo più fitto
-  if(depth >= MAX_DEPTH) {
-    return;
-  }
-
-  if(depth < MIN_DEPTH || sq_vals[0][0] != oProfit) {
-    pool.push(runThread, ref(pool), ref(in), seed, ref(profits),
-      sq_vals_t { { sq_vals[0][0], dots[0][0] }, { dots[0][1], oProfit } },
-      pos_t { .wTimeIdx = pos.wTimeIdx - (1 << (MAX_DEPTH - depth - 1)), .maxDevIdx = pos.maxDevIdx - (1 << (MAX_DEPTH - depth - 1)) },
-      depth + 1
-    );
-  }
-  if(depth < MIN_DEPTH || sq_vals[0][1] != oProfit) {
-    pool.push(runThread, ref(pool), ref(in), seed, ref(profits),
-      sq_vals_t { { dots[0][0], sq_vals[0][1] }, { oProfit, dots[1][0] } },
-      pos_t { .wTimeIdx = pos.wTimeIdx + (1 << (MAX_DEPTH - depth - 1)), .maxDevIdx = pos.maxDevIdx - (1 << (MAX_DEPTH - depth - 1)) },
-      depth + 1
-    );
-  }
-  if(depth < MIN_DEPTH || sq_vals[1][0] != oProfit) {
-    pool.push(runThread, ref(pool), ref(in), seed, ref(profits),
-      sq_vals_t { { dots[0][1], oProfit }, { sq_vals[1][0], dots[1][1] } },
-      pos_t { .wTimeIdx = pos.wTimeIdx - (1 << (MAX_DEPTH - depth - 1)), .maxDevIdx = pos.maxDevIdx + (1 << (MAX_DEPTH - depth - 1)) },
-      depth + 1
-    );
-  }
-  if(depth < MIN_DEPTH || sq_vals[1][1] != oProfit) {
-    pool.push(runThread, ref(pool), ref(in), seed, ref(profits),
-      sq_vals_t { { oProfit, dots[1][0] }, { dots[1][1], sq_vals[1][1] } },
-      pos_t { .wTimeIdx = pos.wTimeIdx + (1 << (MAX_DEPTH - depth - 1)), .maxDevIdx = pos.maxDevIdx + (1 << (MAX_DEPTH - depth - 1)) },
-      depth + 1
-    );
-  }
-
-}
-
 int main() {
   auto nHWThreads = thread::hardware_concurrency();
 
   cout << "HW Threads: " << nHWThreads << endl;
   
-  cout << "Initializing thread pool" << endl;
-  ctpl::thread_pool pool(nHWThreads);
-
   cout << "Reading input" << endl;
   TOP_Input in;
   {
@@ -256,56 +119,20 @@ int main() {
     (mt19937::result_type)rd() ^
     (mt19937::result_type)millis;
 
-  safe_map<pos_t, int> profits;
+  ParamSearch search({ { "wTime", WT_MIN, WT_MAX }, { "maxDev", MDEV_MIN, MDEV_MAX } }, MIN_DEPTH, MAX_DEPTH);
 
-  sq_vals_t sq_vals = { {-1, -1}, {-1, -1} };
-
-  // Calcola bordi
-  cout << "Computing corner values" << endl;
-  {
-    mt19937 rng(seed);
+  cout << "Starting search" << endl;
+  search.Run([&in, seed](const ParamSearch::point_t& x) {
+    mt19937 rng(seed); // Fissa il seed per avere una soluzione stabile a blocchi
     TOP_Output out(in);
-    GreedySolver(in, out, rng, 1.0, WT_MIN, MDEV_MIN, 0);
-    sq_vals[0][0] = out.PointProfit();
-  }
-  {
-    mt19937 rng(seed);
-    TOP_Output out(in);
-    GreedySolver(in, out, rng, 1.0, WT_MIN, MDEV_MAX, 0);
-    sq_vals[0][1] = out.PointProfit();
-  }
-  {
-    mt19937 rng(seed);
-    TOP_Output out(in);
-    GreedySolver(in, out, rng, 1.0, WT_MAX, MDEV_MIN, 0);
-    sq_vals[1][0] = out.PointProfit();
-  }
-  {
-    mt19937 rng(seed);
-    TOP_Output out(in);
-    GreedySolver(in, out, rng, 1.0, WT_MAX, MDEV_MAX, 0);
-    sq_vals[1][1] = out.PointProfit();
-  }
-
-  cout << "Starting pool" << endl;
-  pool.push(runThread, ref(pool), ref(in), seed, ref(profits), sq_vals,
-    pos_t { .wTimeIdx = 1 << (MAX_DEPTH-1), .maxDevIdx = 1 << (MAX_DEPTH-1) },
-    1
-  );
-
-  cout << "Waiting on pool" << endl;
-  //this_thread::sleep_for(chrono::seconds(1));
-  do {
-    this_thread::sleep_for(chrono::seconds(1));
-    cerr << ".";
-  } while(pool.n_idle() < pool.size());
-  cerr << endl;
-  pool.stop(true); // Wait for solution
+    GreedySolver(in, out, rng, 1.0, x[0], x[1], 0);
+    return (double)out.PointProfit();
+  }, nHWThreads);
 
-  cout << "Computations: " << profits._map.size() << endl;
+  cout << "Computations: " << search.Values().size() << endl;
 
   set<int> profits_distinct;
-  for(const auto& mapEntry : profits._map) {
+  for(const auto& mapEntry : search.Values()) {
     profits_distinct.insert(mapEntry.second);
   }
 
@@ -318,8 +145,9 @@ int main() {
     if(!ofs) {
       throw new runtime_error("Unable to open file");
     }
-    for(const auto& mapEntry : profits._map) {
-      ofs << wTimeFromIdx(mapEntry.first.wTimeIdx) << '\t' << maxDevFromIdx(mapEntry.first.maxDevIdx) << '\t' << mapEntry.second << endl;
+    for(const auto& mapEntry : search.Values()) {
+      auto x = search.Point(mapEntry.first);
+      ofs << x[0] << '\t' << x[1] << '\t' << mapEntry.second << endl;
     }
   }
 
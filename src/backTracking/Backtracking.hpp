@@ -3,8 +3,21 @@
 
 #include <iostream>
 #include <chrono>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <algorithm>
 using namespace std::chrono;
 
+// Depth of the nodes that are the roots of the first tasks of ParallelBacktrack
+#ifndef BACKTRACK_SPLIT_DEPTH
+#define BACKTRACK_SPLIT_DEPTH 1
+#endif
+
 /**
  * Class that represent the state and extend the concept of output
  */
@@ -41,6 +54,41 @@ enum NodeBound {
   NB_NonImproving
 };
 
+/**
+ * Best cost found by the checkers of all the threads, read and lowered without locks
+ */
+template<typename _Cost>
+class SharedIncumbent {
+  public:
+    SharedIncumbent(_Cost cost) : cost(cost), found(false) {}
+
+    _Cost Load() const { return cost.load(std::memory_order_relaxed); }
+
+    // True after the first Offer accepted (a solution has been found by a thread)
+    bool Found() const { return found.load(std::memory_order_relaxed); }
+
+    /**
+     * Lower the shared cost to newCost if it is better
+     *
+     * @param newCost cost of a solution
+     * @return true if newCost is the new shared cost
+     */
+    bool Offer(_Cost newCost) {
+      _Cost old = cost.load(std::memory_order_relaxed);
+      while(newCost < old) {
+        if(cost.compare_exchange_weak(old, newCost, std::memory_order_relaxed)) {
+          found.store(true, std::memory_order_relaxed);
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    std::atomic<_Cost> cost;
+    std::atomic<bool> found;
+};
+
 /**
  * Class that represent the checker of the consistency of the current state and also provided
  * some useful functions to update or clear the data of one node
@@ -61,14 +109,47 @@ class BoundChecker {
     virtual bool UpdateBest(const _Node& n) { // Can be used to update bounds (but shouldn't) and return if best
       auto newCost = n.GetCost();
       //std::cerr << "Cost comparison: old " << bestCost << ", new " << newCost << std::endl;
-      if(newCost < bestCost) {
+      if(newCost < BoundCost()) {
         //std::cerr << "Saving new best..." << std::endl;
         bestNode = n; //typename _Node::Output(n); // Implicit cast
         bestCost = newCost;
+        if(incumbent != nullptr) {
+          incumbent->Offer(newCost);
+        }
         return true;
       }
       return false;
     }
+
+    /**
+     * Share the best cost with the checkers of other threads: the nodes are pruned and the solutions are
+     * saved only if better than the best of all the checkers (each checker keeps its own best node)
+     *
+     * @param incumbent shared cost (nullptr to stop sharing)
+     * @return [void]
+     */
+    void ShareIncumbent(SharedIncumbent<typename _Node::Cost>* incumbent) { this->incumbent = incumbent; }
+
+    /**
+     * Take the best node of other if it is better than the one of this checker
+     *
+     * @param other checker of the same problem
+     * @return [void]
+     */
+    void MergeBest(const BoundChecker& other) {
+      if(other.bestCost < bestCost) {
+        bestNode = other.bestNode;
+        bestCost = other.bestCost;
+      }
+    }
+
+    /**
+     * Divide the memory of the caches of the checker (if any) among parts copies working on the same search
+     *
+     * @param parts number of copies
+     * @return [void]
+     */
+    virtual void SplitResources(int parts) {}
     //bool IsNonImproving(const Node& n); // Can be not implemented
     //bool IsFeasible(const Node& n) { return n.IsFeasible(); }; // Can be not implemented
     // And be more restrictive due to learnt nogoods or something like that
@@ -79,6 +160,12 @@ class BoundChecker {
   protected:
     typename _Node::Output bestNode;
     typename _Node::Cost bestCost;
+    SharedIncumbent<typename _Node::Cost>* incumbent = nullptr;
+
+    // Cost to improve: the best of this checker or of any checker sharing the incumbent
+    typename _Node::Cost BoundCost() const {
+      return incumbent != nullptr ? std::min(bestCost, incumbent->Load()) : bestCost;
+    }
 };
 
 /**
@@ -181,4 +268,197 @@ void Backtrack(TreeWalker<_Node>& walker, BoundChecker<_Node>& checker, double m
   std::cerr << "Completed after " << count << " iterations @" << duration_cast<duration<double>>(finish - start).count() << "s" << std::endl;
 }
 
+/**
+ * Execute the Backtracking algorithm on nThreads threads. The tree is split at splitDepth: every node at that
+ * depth (or leaf above it) is the root of a task, and a task is explored by a worker as Backtrack does, never
+ * going above its root. When a worker is idle and no task is queued, a busy worker gives away the unexplored
+ * siblings of its shallowest open level as a new task (the task is a path plus the flag to skip the node
+ * reached by it). Every worker owns a copy of the walker, moved to the root of its task replaying the path, and
+ * a copy of the checker; the checkers share the incumbent, so every thread prunes with the best cost of all,
+ * and their caches split the memory of the one of checker (SplitResources).
+ * At the end checker holds the best solution found. The order of the visit depends on the threads, so the
+ * solution can differ from the one of Backtrack when the search is not completed.
+ *
+ * The walker must provide the type Step of a move, Path(depth) that returns the moves from the root to the
+ * current node at depth, and GoToPath(path) that moves to the node reached by a path returned by Path.
+ *
+ * @param walker class that allow to walk into the solutions tree (copied by every worker)
+ * @param checker class that allow to check the consistency of one solution (copied by every worker)
+ * @param maxTime time max allow to the problem to solve one instance
+ * @param nThreads number of workers (0 for the hardware threads)
+ * @param splitDepth depth of the roots of the first tasks
+ * @return void
+ */
+template<typename _Walker, typename _Checker>
+void ParallelBacktrack(const _Walker& walker, _Checker& checker, double maxTime, int nThreads = 0, int splitDepth = BACKTRACK_SPLIT_DEPTH) {
+  typedef typename _Walker::Step Step;
+  typedef decltype(checker.GetBestCost()) Cost;
+  struct Task {
+    std::vector<Step> path; // Root of the subtree
+    bool siblings; // The root is explored by another task, explore the siblings after it
+  };
+
+  if(nThreads <= 0) {
+    nThreads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  checker.Reset();
+  auto start = high_resolution_clock::now();
+  auto elapsed = [&start]() { return duration_cast<duration<double>>(high_resolution_clock::now() - start).count(); };
+
+  // The nodes at splitDepth (or the leaves above it) in the order of Backtrack
+  std::deque<Task> tasks;
+  {
+    _Walker splitter(walker);
+    _Checker splitChecker(checker); // The caches of checker are not filled
+    splitter.GoToRoot();
+    int depth = 0;
+    while(true) {
+      if(splitChecker.CheckNode(splitter.GetNode()) != NodeBound::NB_UnFeasible) {
+        if(depth < splitDepth && splitter.GoToChild()) {
+          ++depth;
+          continue;
+        }
+        tasks.push_back({ splitter.Path(depth), false });
+      }
+      while(depth > 0 && !splitter.GoToSibiling()) {
+        splitter.GoToParent();
+        --depth;
+      }
+      if(depth == 0) {
+        break;
+      }
+    }
+  }
+
+  SharedIncumbent<Cost> incumbent(checker.GetBestCost());
+  std::vector<_Checker> checkers(nThreads, checker);
+  for(auto& ck : checkers) {
+    ck.SplitResources(nThreads);
+  }
+  std::mutex mutex, logMutex;
+  std::condition_variable wakeUp;
+  int active = 0; // Workers exploring a task (guarded by mutex)
+  std::atomic<int> hungry(0); // Workers waiting for a task (changed under mutex)
+  std::atomic<bool> stop(false); // Time limit reached or error
+  std::atomic<unsigned long> count(0);
+  std::exception_ptr error; // First exception of the workers (guarded by mutex)
+
+  auto work = [&](int id) {
+    _Walker w(walker);
+    _Checker& ck = checkers[id];
+    ck.ShareIncumbent(&incumbent);
+    unsigned long localCount = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+      while(tasks.empty() && active > 0 && !stop) {
+        ++hungry;
+        wakeUp.wait(lock);
+        --hungry;
+      }
+      if(tasks.empty() || stop) {
+        break; // Explored or stopped
+      }
+      Task task = std::move(tasks.front());
+      tasks.pop_front();
+      ++active;
+      lock.unlock();
+
+      try {
+        w.GoToPath(task.path);
+        int rootDepth = task.path.size(), depth = rootDepth;
+        bool siblings = task.siblings;
+        bool backtrack = siblings; // The node reached belongs to another task
+        bool ended = false;
+
+        while(!ended && !stop) {
+          if(!backtrack && hungry.load(std::memory_order_relaxed) > 0 && (siblings || depth > rootDepth)) {
+            std::lock_guard<std::mutex> donateLock(mutex);
+            if(tasks.size() < (size_t)hungry.load()) { // Give away the siblings of the shallowest open level
+              if(!siblings) {
+                ++rootDepth;
+              }
+              tasks.push_front({ w.Path(rootDepth), true });
+              siblings = false;
+              wakeUp.notify_one();
+            }
+          }
+
+          if(!backtrack) {
+            auto nodeBound = ck.CheckNode(w.GetNode());
+            if(incumbent.Found()) {
+              backtrack = nodeBound != NodeBound::NB_Normal;
+            } else {
+              backtrack = nodeBound == NodeBound::NB_UnFeasible;
+            }
+          }
+          if(backtrack) {
+            while(true) {
+              if((depth > rootDepth || (depth == rootDepth && siblings)) && w.GoToSibiling()) {
+                ++localCount;
+                backtrack = false;
+                break;
+              }
+              if(depth <= rootDepth) { // Subtree explored
+                ended = true;
+                break;
+              }
+              w.GoToParent();
+              --depth;
+            }
+          } else {
+            if(w.GoToChild()) {
+              ++localCount;
+              ++depth;
+            } else {
+              if(ck.UpdateBest(w.GetNode())) {
+                std::lock_guard<std::mutex> logLock(logMutex);
+                std::cerr << "New best solution " << " (cost " << ck.GetBestCost() << ", iter " << localCount
+                          << ", thread " << id << " @" << elapsed() << "s)" << std::endl;
+              }
+              backtrack = true; // Continue search
+            }
+          }
+          if(elapsed() >= maxTime) {
+            stop = true;
+          }
+        }
+      } catch(...) {
+        std::lock_guard<std::mutex> errorLock(mutex);
+        if(!error) {
+          error = std::current_exception();
+        }
+        stop = true;
+      }
+
+      lock.lock();
+      --active;
+      if(stop || (active == 0 && tasks.empty())) {
+        wakeUp.notify_all();
+      }
+    }
+    count += localCount;
+  };
+
+  std::vector<std::thread> workers;
+  for(int id = 0; id < nThreads; ++id) {
+    workers.emplace_back(work, id);
+  }
+  for(auto& worker : workers) {
+    worker.join();
+  }
+  if(error) {
+    std::rethrow_exception(error);
+  }
+
+  for(const auto& ck : checkers) {
+    checker.MergeBest(ck);
+  }
+  if(stop) {
+    std::cerr << "Cannot complete after " << elapsed() << "s" << std::endl;
+  } else {
+    std::cerr << "Completed after " << count << " iterations @" << elapsed() << "s" << std::endl;
+  }
+}
+
 #endif
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include <algorithm>
 #include <vector>
+#include <stdexcept>
+#include <cmath>
+#include <limits>
 
 using namespace std;
 
@@ -10,17 +13,6 @@ using namespace std;
  * Declaration *
  ***************/
 
-/**
- * Struct to better manage the choice into the branch tree: reppresent
- * the couple of point (with its rating) and car choose in the GoToChild 
- * or GoToParent moves 
- */
-struct pointRating { 
-  idx_t point;
-  double rating;
-  idx_t car;
-};
-
 /**
  * Choose the car to assign to one specific point, in particular it choose only 
  * the car feasible and the nearest to the point. 
@@ -42,35 +34,6 @@ idx_t choseCar(TOP_Node& current, vector<idx_t> carSorted, idx_t c, idx_t p);
  */
 bool verifyFeasibility(const TOP_Node& current, idx_t p);
 
-/**
- * Calculate one component of the rating assigned to one point. Estimate the possible profit losses
- * if one point isn't chosen, by summing all the point profits in the ellipse, which area is drawn
- * from the remaining time of the car and the point p. The result is a value without a unit of measure.
- *
- * @param current class that represent the current state of the problem 
- * @param car the car from which it could be calculate the rating 
- * @param p the point considered
- * @param sumProfit the profit sum of all points profit 
- * @return point profits in the ellipse divided by all the points profit 
- */
-double NonChoicheCost(TOP_Node& current, idx_t car, idx_t p, double sumProfit);
-
-/**
- * Calculate the rating assigned to one point, which is made up of three components: the first is 
- * referring to the point profit on the mean of remaining points profit, the second one is referring 
- * to the remaining traveltime of the nearest car to the point and the impact it would have in entering 
- * that point and at least the cost (losses) of no choosing that point. The function is provided of boolean 
- * variable that distinguish if the rating is calculated from the nearest car (false) or from all the cars 
- * that aren't the nearest (true) to the considered poit p passed by variable.
- * 
- * @param ocurrent class that represent the current state of the problem 
- * @param p the point considered
- * @param c the car that the rating is calculated
- * @param Mod bool value that distinguish the two case of Rating points
- * @return rating of the point p
- */
-double RatingChoice(TOP_Node& current, idx_t p, idx_t c, bool Mod, double wProfit, double wTime, double wNonCost);
-
 /**
  * After choosing one point to insert in the nearest car, determinate if there is one point to insert between 
  * the point and the last inserted in the car, condition of inserting: the nearest point. The maximum deviation 
@@ -79,23 +42,31 @@ double RatingChoice(TOP_Node& current, idx_t p, idx_t c, bool Mod, double wProfi
  * @param ocurrent class that represent the current state of the problem 
  * @param car the car which path is modified 
  * @param maxDeviationAdmitted max deviation admitted on the path of the car
+ * @param scratch buffers reused between the calls
  * @return integer value rappresentative of the index of point inserted by the function
  */
-idx_t InsertPoint(TOP_Node& current, idx_t point, idx_t car, double maxDeviationAmmitted);
+idx_t InsertPoint(TOP_Node& current, idx_t point, idx_t car, double maxDeviationAmmitted, insertScratch& scratch);
 
 /**
  * Based on the current state, this function generate a vector of couple car-point ordered by rating.
  * The model of the function is similar to the greedy algorithm and use its parameters and functions 
- * appropriately modifed
+ * appropriately modifed. The cars with the same last point and travel distance are symmetric: with carSymmetry
+ * only the couples of the first car of each class are generated.
  * 
+ * @param ratingPoints filled with the couples of points and cars ordered by their rating (the memory is reused)
  * @param current class that represent the current state of the problem 
+ * @param ratings buffers of the ratings, computed by TOP_Ratings for all the points in one pass
  * @param wTime weight of time cost component
  * @param maxDeviation max deviation admitted in the path for InsertPoint (metaheuristic mode)
  * @param wNonCost weight of non-cost component
  * @param nonGreedyDrop drop to apply to non-greedy points (normally >= 0)
- * @return the vector of the couple of points and cars ordered by their rating
+ * @param granularK if positive only the granularK nearest neighbors of the last points of the cars are rated
+ *                  (all the points if none of them is feasible)
+ * @param carSymmetry if true the symmetric cars are moved only once
+ * @param scratch buffers of InsertPoint
+ * @return [void]
  */
-std::vector<pointRating> ratingVectorGenerator(TOP_Node& current, double wProfit, double wTime, double maxDeviation, double wNonCost, double nonGreedyDrop);
+void ratingVectorGenerator(std::vector<pointRating>& ratingPoints, TOP_Node& current, TOP_Ratings& ratings, double wProfit, double wTime, double maxDeviation, double wNonCost, double nonGreedyDrop, idx_t granularK, bool carSymmetry, insertScratch& scratch);
 
 /******************
  * Implementation *
@@ -122,129 +93,24 @@ idx_t choseCar(TOP_Node& current, vector<idx_t> carSorted, idx_t c, idx_t p) {
 }
 
 bool verifyFeasibility(const TOP_Node& current, idx_t p) {
-  NumberRange<idx_t> carIdxs(current.in.Cars());
-
-  for(const auto& car : carIdxs) { // Verify that there is at least one car that can insert the point
-    if(current.SimulateMoveCar(car, p).feasible) {
-      return true;
-    }
-  }
-  return false; // Otherwise
+  // Verify that there is at least one car that can insert the point (bit test when the masks are updated)
+  return current.ReachableByAny(p);
 }
 
-double NonChoicheCost(TOP_Node& current, idx_t car, idx_t p, double sumProfit) {
-  double profitElipse = 0.0;
-  
-  current.MoveCar(car, p);
-  for(idx_t point = 0; point < current.in.Points(); ++point) { // If is not already visited
-    if(current.Visited(point)) {
-      continue;
-    }
- 
-    if(current.SimulateMoveCar(car, point).feasible) { // If can be reached by the selected car
-      profitElipse += current.in.Point(point).Profit();
-    }
-  }
-  current.RollbackCar(car);
-  if(sumProfit == 0.0) {
-    return INFINITY;
-  }
-  return profitElipse / sumProfit;
-}
-
-double RatingChoice(TOP_Node& current, idx_t p, idx_t c, bool Mod, double wProfit, double wTime, double wNonCost) {
-  NumberRange<idx_t> carIdxs(current.in.Cars());
-  NumberRange<idx_t> pointIdxs(current.in.Points());
-
-  double profit = current.in.Point(p).Profit();
-  double notVisitedCount = 0.0;
-  double sumProfit = 0.0;
-  idx_t chosenCar;
-
-  if (current.Visited(p) || !verifyFeasibility(current, p)) {
-    return -INFINITY;
-  }
-  
-  // Factor dependent on the profit   
-  for(const auto& p : pointIdxs) {
-    if(!current.Visited(p)) {
-      sumProfit += current.in.Point(p).Profit();
-      ++notVisitedCount;
-    }
-  }
-  double meanProfit;
-  if(notVisitedCount == 0.0) {
-    meanProfit = INFINITY;
-  }
-  else {
-    meanProfit = sumProfit / notVisitedCount;
-  }
-
-  if (Mod && c == current.in.Cars()) {
-    throw runtime_error("    ERROR: This condition could not exist");
-  }
-  
-  if (Mod) { // RatingPointModified
-    chosenCar = c;
-  }
-  else { // Normal Rating point
-    chosenCar = *min_element(carIdxs.begin(), carIdxs.end(), [&current, &p](idx_t c1, idx_t c2) {
-      // If marked travel time is infinite!
-      return current.in.Distance(p, current.CarPoint(c1)) < current.in.Distance(p, current.CarPoint(c2));
-    });
-  }
-  double gamma = current.TravelTime(chosenCar) / current.in.MaxTime();
-
-  // Factor dependent on the traveltime
-  double extraTravelTimeNorm;
-  if(current.in.MaxTime() - current.TravelTime(chosenCar) == 0.0) {
-    extraTravelTimeNorm = INFINITY;
-  }
-  else {
-    extraTravelTimeNorm = current.SimulateMoveCar(chosenCar, p).extraTravelTime / (current.in.MaxTime() - current.TravelTime(chosenCar));
-  }
-
-  // Factor dependent on the cost (losses) of chosing another point
-  double noChoice = NonChoicheCost(current, chosenCar, p, sumProfit);
-
-  // cerr <<
-  //  "LOG: return ratingModified " << (profit/meanProfit) - (gamma*extraTravelTimeNorm) + noChoice <<
-  //   " for point " << p << " and car " << chosencar << endl;
-
-  return wProfit * (profit / meanProfit) - wTime * (gamma * extraTravelTimeNorm) + wNonCost * noChoice;
-}
-
-idx_t InsertPoint(TOP_Node& current, idx_t point, idx_t car, double maxDeviationAmmitted) {
-  NumberRange<idx_t> pointIdxs(current.in.Points());
-  vector<idx_t> inEllipse;
+idx_t InsertPoint(TOP_Node& current, idx_t point, idx_t car, double maxDeviationAmmitted, insertScratch& scratch) {
+  vector<idx_t>& inEllipse = scratch.inEllipse;
+  vector<uint64_t>& ellipseMask = scratch.ellipseMask;
+  inEllipse.clear();
+  ellipseMask.resize(MaskWords(current.in.Points())); // Cleared by DetourMask
 
   // Add to the list all the point which distance is lower than the max deviation admitted
-  for(idx_t p = 1; p < (current.in.Points() - 1); ++p) {
-    // cerr << "LOG: insertPoint starting find inEllipse points " << car << " " << current.CarPoint(car) << " " << i << endl;
-    if(current.Visited(p) || p == point) {
-      continue;
-    }
-    double ellipseDist =
-      + current.in.Distance(current.CarPoint(car), p)
-      + current.in.Distance(p, point)
-      - current.in.Distance(current.CarPoint(car), point);
-    
-    // cerr <<
-    //   "LOG: from " << current.CarPoint(car) << " to " <<  point << " taking " <<
-    //   i << ": " << ellipseDist << " (" << current.Hop(car, current.Hops(car)-1) << ")" << endl;
-
-    // cerr <<
-    //   "LOG: distance 1: " << current.in.Distance(current.CarPoint(car), i) << " distance 2: " <<
-    //   current.in.Distance(i, point) << " maxDeviation: " << maxDeviationAmmitted << endl;
-    
-    if(ellipseDist > maxDeviationAmmitted) {
-      // cerr <<
-      //   "LOG: Distance point " << i << " from point " << point << " is more than " <<
-      //   maxDeviationAmmitted << " (" << ellipseDist << ")" << endl;
-      continue;
+  current.in.DetourMask(current.CarPoint(car), point, 0.0, maxDeviationAmmitted, ellipseMask.data());
+  ForEachMaskBit(ellipseMask.data(), ellipseMask.size(), [&current, &inEllipse, point](idx_t p) {
+    if(p < 1 || p >= (current.in.Points() - 1) || current.Visited(p) || p == point) {
+      return;
     }
     inEllipse.push_back(p);
-  }
+  });
 
   // cerr << "LIST: of car: " << car << " " << current.CarPoint(car) << " -> " << point << ": ";
   // for(idx_t p : inEllipse) { cerr << p << ", "; }
@@ -261,16 +127,16 @@ idx_t InsertPoint(TOP_Node& current, idx_t point, idx_t car, double maxDeviation
     //cerr << "LOG: Point choose: " << node << " into car " << car << endl;
 
     // Verify the feasibility of the insertion
-    double dist =
-      + current.TravelTime(car)
-      - current.in.Distance(current.CarPoint(car), current.in.EndPoint())
-      + current.in.Distance(current.CarPoint(car), node)
-      + current.in.Distance(node, point)
-      + current.in.Distance(point, current.in.EndPoint());
+    dist_t dist =
+      + current.TravelDist(car)
+      - current.in.Dist(current.CarPoint(car), current.in.EndPoint())
+      + current.in.Dist(current.CarPoint(car), node)
+      + current.in.Dist(node, point)
+      + current.in.Dist(point, current.in.EndPoint());
 
     // cerr << "LOG: Distance of point: " << node << " -> " << dist << " on " << current.in.MaxTime() << endl;
 
-    if(dist <= current.in.MaxTime()) { // If can be inserted into the path
+    if(dist <= current.in.MaxDist()) { // If can be inserted into the path
       return node;
     } 
     // If can't be possible to insert, return the point passed by variable
@@ -281,11 +147,44 @@ idx_t InsertPoint(TOP_Node& current, idx_t point, idx_t car, double maxDeviation
   }
 }
 
-std::vector<pointRating> ratingVectorGenerator(TOP_Node& current, double wProfit, double wTime, double maxDeviation, double wNonCost, double nonGreedyDrop) {
+void ratingVectorGenerator(std::vector<pointRating>& ratingPoints, TOP_Node& current, TOP_Ratings& ratings, double wProfit, double wTime, double maxDeviation, double wNonCost, double nonGreedyDrop, idx_t granularK, bool carSymmetry, insertScratch& scratch) {
   NumberRange<idx_t> carIdxs(current.in.Cars()); 
   NumberRange<idx_t> pointIdxs(current.in.Points() - 1);
   std::vector<idx_t> carSorted = carIdxs.Vector();
-  std::vector<pointRating> ratingPoints;
+  ratingPoints.clear();
+  current.UpdateReachable(); // Only the cars moved since the last generation
+  ratings.Update(current);
+
+  // The cars are identical: the cars with the same last point and travel distance lead to the same subtrees (with
+  // the routes permuted), only the first car of each class is moved (a new route starts only on the first empty car)
+  std::vector<idx_t> carClass(current.in.Cars());
+  for(idx_t car : carIdxs) {
+    carClass[car] = car;
+    for(idx_t other = 0; carSymmetry && other < car; ++other) {
+      if(current.CarPoint(other) == current.CarPoint(car) && current.TravelDist(other) == current.TravelDist(car)) {
+        carClass[car] = other;
+        break;
+      }
+    }
+  }
+
+  bool rated = false;
+  if(granularK > 0) { // Only the nearest neighbors of the last points of the cars
+    std::vector<uint64_t> candidates(MaskWords(current.in.Points()));
+    for(idx_t car : carIdxs) {
+      const idx_t* near = current.in.Neighbors(current.CarPoint(car));
+      for(idx_t i = 0; i < granularK; ++i) {
+        candidates[near[i] / 64] |= uint64_t(1) << (near[i] % 64);
+      }
+    }
+    ratings.RateAll(current, wProfit, wTime, wNonCost, TOP_Ratings::REACHABLE_PROFIT, candidates.data());
+    ForEachMaskBit(candidates.data(), candidates.size(), [&ratings, &rated](idx_t p) {
+      rated = rated || ratings.Rating(p) != -INFINITY;
+    });
+  }
+  if(!rated) { // All the points (also when no neighbor is feasible)
+    ratings.RateAll(current, wProfit, wTime, wNonCost, TOP_Ratings::REACHABLE_PROFIT);
+  }
 
   // Determinate the rating for each point for the nearest car, as the greedy algorithm
   for(idx_t p : pointIdxs) {
@@ -294,7 +193,7 @@ std::vector<pointRating> ratingVectorGenerator(TOP_Node& current, double wProfit
     pointRating currentPoint, otherCarPoint;
     bool alreadyInsert = false;
     bool alreadyInsertPlus = false;
-    double rating = RatingChoice(current, p, current.in.Cars(), false, wProfit, wTime, wNonCost);
+    double rating = ratings.Rating(p); // For the nearest car
 
     if(rating == -INFINITY) { // The point is already visited or unfeasible
       continue;
@@ -302,7 +201,10 @@ std::vector<pointRating> ratingVectorGenerator(TOP_Node& current, double wProfit
 
     // Chose the couple point-car and its rating based on the couple itself
     currentPoint.car = choseCar(current, carSorted, current.in.Cars(), p);
-    currentPoint.point = InsertPoint(current, p, currentPoint.car, maxDeviation);
+    if(currentPoint.car < current.in.Cars()) {
+      currentPoint.car = carClass[currentPoint.car];
+    }
+    currentPoint.point = InsertPoint(current, p, currentPoint.car, maxDeviation, scratch);
     currentPoint.rating = rating;
     idx_t indexSwap = 0;
 
@@ -333,13 +235,13 @@ std::vector<pointRating> ratingVectorGenerator(TOP_Node& current, double wProfit
 
     // Determinate the rating for each point for the other cars
     for(idx_t c : carIdxs) {
-      if(c == currentPoint.car) { // Avoid to use the same car as before
+      if(c == currentPoint.car || carClass[c] != c) { // Avoid to use the same car as before (or one of its class)
         continue;
       }
       // cerr << "LOG: select car " << c << endl;
       otherCarPoint.car = c;
-      otherCarPoint.point = InsertPoint(current, p, c, maxDeviation);
-      otherCarPoint.rating = RatingChoice(current, p, c, true, wProfit, wTime, wNonCost) - nonGreedyDrop;
+      otherCarPoint.point = InsertPoint(current, p, c, maxDeviation, scratch);
+      otherCarPoint.rating = ratings.Rating(current, c, p) - nonGreedyDrop;
 
       alreadyInsert = false;
       alreadyInsertPlus = false;
@@ -375,19 +277,29 @@ std::vector<pointRating> ratingVectorGenerator(TOP_Node& current, double wProfit
     return p1.rating > p2.rating; // Sort by rating from higher to lower
   });
 
+  // The swaps above can leave the same couple twice: GoToSibiling looks for the first one, so the sibilings
+  // between the two would be visited again and again. Keep only the first one.
+  std::vector<bool> listed(current.in.Points() * current.in.Cars());
+  ratingPoints.erase(std::remove_if(ratingPoints.begin(), ratingPoints.end(), [&listed, &current] (const pointRating& p) {
+    idx_t key = p.car * current.in.Points() + p.point;
+    bool repeated = listed[key];
+    listed[key] = true;
+    return repeated;
+  }), ratingPoints.end());
+
   // cerr << "LOG: vector after (";
   // for(int p = 0; p < ratingPoints.size(); p++) {
   //   cerr << ratingPoints[p].point << " " << ratingPoints[p].rating << " " << ratingPoints[p].car << ", "; }
   // cerr << ")" << endl;
-  return ratingPoints; 
 }
 
 bool TOP_Walker::GoToChild() {
-  NumberRange<idx_t> carIdxs(current.in.Cars()); 
-  NumberRange<idx_t> pointIdxs(current.in.Points() - 1);
-  
-  std::vector<idx_t> carSorted = carIdxs.Vector();
-  std::vector<pointRating> ratingPoints = ratingVectorGenerator(current, wProfit, wTime, maxDeviation, wNonCost, nonGreedyDrop);
+  size_t depth = carAssignmentOrder.size();
+  if(levelRatings.size() <= depth) {
+    levelRatings.emplace_back();
+  }
+  std::vector<pointRating>& ratingPoints = levelRatings[depth]; // Kept for the sibilings of the child
+  ratingVectorGenerator(ratingPoints, current, ratings, wProfit, wTime, maxDeviation, wNonCost, nonGreedyDrop, granularK, carSymmetry, scratch);
 
   if(ratingPoints.empty()) { // If empty, can't go down to the branch
     //cerr << "LOG: empty (end of branch)" << endl;
@@ -395,6 +307,7 @@ bool TOP_Walker::GoToChild() {
   }
 
   //Chose the next point with it's own car based on the previous choice
+  auto mark = current.Mark();
   for(idx_t idx = 0; idx < ratingPoints.size(); ++idx) {
     // if(idx != current.CarPoint(carAssignmentOrder.back())) {
     //   continue;
@@ -406,43 +319,35 @@ bool TOP_Walker::GoToChild() {
     // cerr << "LOG: " << ratingPoints[idx].car << " " << ratingPoints[idx].point << " " << ratingPoints[idx].rating << endl;
     if(current.MoveCar(ratingPoints[idx].car, ratingPoints[idx].point, false).feasible) { // Assign to its car
       carAssignmentOrder.push_back(ratingPoints[idx].car);
+      pointAssignmentOrder.push_back(ratingPoints[idx].point);
+      levelMarks.push_back(mark);
+      levelCursors.push_back(idx);
       // cerr << "LOG: insert point " << ratingPoints[idx].point << " into car " << ratingPoints[idx].car << endl;
       // cerr << "LOG: profit " << current.PointProfit() << endl;
       return true;
     }
   }
   //cerr << "LOG: profit " << current.PointProfit() << endl;
+  current.Release();
   return false; // Not possible to insert any point (finish that branch)
 }
 
 bool TOP_Walker::GoToSibiling() {
-  NumberRange<idx_t> carIdxs(current.in.Cars()); 
-  NumberRange<idx_t> pointIdxs(current.in.Points()-1);
-  std::vector<idx_t> carSorted = carIdxs.Vector();
-  
   // Get current car assignment and try to change permutation lexicographically
   if(carAssignmentOrder.empty()) { // If empty, can't go to the sibiling of the same branch
     return false;
   }
 
-  idx_t car = carAssignmentOrder.back(); // Remove and save info about the point 
-  idx_t point = current.RollbackCar(car);
-  // std::cerr << "LOG: remove from " << car <<  " -> " << point << endl;
-
-  std::vector<pointRating> ratingPoints = ratingVectorGenerator(current, wProfit, wTime, maxDeviation, wNonCost, nonGreedyDrop);
+  current.UndoTo(levelMarks.back()); // Back to the parent, whose couples are the ones of the level
+  const std::vector<pointRating>& ratingPoints = levelRatings[carAssignmentOrder.size() - 1];
 
   // cerr << "LOG: vector Sibiling (";
   // for(int p = 0; p < ratingPoints.size(); ++p) {
   //   cerr << ratingPoints[p].point << " " << ratingPoints[p].rating << " " << ratingPoints[p].car << ", "; }
   // cerr << ")" << endl;
 
-  idx_t prev_idx = 0;
-  // Go to point in ratingPoints matching (point, car)
-  while(prev_idx < ratingPoints.size() && (ratingPoints[prev_idx].point != point || ratingPoints[prev_idx].car != car)) {
-    ++prev_idx;
-  }
-  // For all points after the previous match
-  for(idx_t idx = prev_idx + 1; idx < ratingPoints.size(); idx++) {
+  // For all points after the current couple
+  for(idx_t idx = levelCursors.back() + 1; idx < ratingPoints.size(); idx++) {
     // Skip already visited points (shouldn't happen because they have -INF rating)
     if(current.Visited(ratingPoints[idx].point)) {
       continue;
@@ -450,13 +355,15 @@ bool TOP_Walker::GoToSibiling() {
     // Valid candidate, try to insert in current state
     if(current.MoveCar(ratingPoints[idx].car, ratingPoints[idx].point, false).feasible) {
       carAssignmentOrder.back() = ratingPoints[idx].car;
+      pointAssignmentOrder.back() = ratingPoints[idx].point;
+      levelCursors.back() = idx;
       // std::cerr << "LOG: Assign to car " << ratingPoints[idx].car << " point " << ratingPoints[idx].point << std::endl;
       return true;
     }
   }
 
-  // If no alternatives return false but in a state where GoToParent rolls back (insert dummy hop)
-  current.MoveCar(car, 0, true);
+  // If no alternatives return false, the state is already the parent one (GoToParent only closes the level)
+  levelCursors.back() = ratingPoints.size();
   return false;
 }
 
@@ -466,29 +373,290 @@ bool TOP_Walker::GoToParent() {
   }
 
   //std::cerr << "LOG: Current tree's depth " << carAssignmentOrder.size() << std::endl; 
-  idx_t car = carAssignmentOrder.back();
-  //std::cerr << "LOG: Rollback point " << current.CarPoint(car) << " from car " << car << endl;
+  //std::cerr << "LOG: Rollback point " << current.CarPoint(carAssignmentOrder.back()) << " from car " << carAssignmentOrder.back() << endl;
   
-  current.RollbackCar(car); // Go up one level into the branch
+  current.UndoTo(levelMarks.back()); // Go up one level into the branch
+  current.Release();
+  levelMarks.pop_back();
   carAssignmentOrder.pop_back(); 
+  pointAssignmentOrder.pop_back();
+  levelCursors.pop_back(); // The vector of the level is kept for the next child
   return true;
 }
 
+std::vector<TOP_Walker::Step> TOP_Walker::Path(size_t depth) const {
+  std::vector<Step> path(depth);
+  for(size_t level = 0; level < depth; ++level) {
+    path[level] = { carAssignmentOrder[level], pointAssignmentOrder[level] };
+  }
+  return path;
+}
+
+void TOP_Walker::GoToPath(const std::vector<Step>& path) {
+  GoToRoot();
+  for(const Step& step : path) { // Same moves of GoToChild and GoToSibiling
+    size_t depth = carAssignmentOrder.size();
+    if(levelRatings.size() <= depth) {
+      levelRatings.emplace_back();
+    }
+    std::vector<pointRating>& ratingPoints = levelRatings[depth]; // The sibilings follow the couple of the step
+    ratingVectorGenerator(ratingPoints, current, ratings, wProfit, wTime, maxDeviation, wNonCost, nonGreedyDrop, granularK, carSymmetry, scratch);
+    idx_t cursor = 0;
+    while(cursor < ratingPoints.size() && (ratingPoints[cursor].point != step.point || ratingPoints[cursor].car != step.car)) {
+      ++cursor;
+    }
+
+    auto mark = current.Mark();
+    if(cursor == ratingPoints.size() || !current.MoveCar(step.car, step.point, false).feasible) {
+      throw logic_error("TOP_Walker: the path cannot be replayed on this instance");
+    }
+    carAssignmentOrder.push_back(step.car);
+    pointAssignmentOrder.push_back(step.point);
+    levelMarks.push_back(mark);
+    levelCursors.push_back(cursor);
+  }
+}
+
 cost_t TOP_Node::GetMinCost() const {
   cost_t profit = PointProfit();
-  for(idx_t point = 0; point < in.Points(); ++point) {
-    if(Visited(point)) {
+  vector<uint64_t> reachable(MaskWords(in.Points())), carReachable(reachable.size());
+  const uint64_t* unvisited = UnvisitedMask();
+
+  // Points that can be reached by any car (the masks are rebuilt only if outdated)
+  for(idx_t car = 0; car < in.Cars(); ++car) {
+    const uint64_t* carMask = ReachableMask(car);
+    if(!ReachableUpdated(car)) {
+      in.DetourMaskDist(CarPoint(car), in.EndPoint(), TravelDist(car), in.MaxDist(), carReachable.data());
+      carMask = carReachable.data();
+    }
+    for(idx_t w = 0; w < reachable.size(); ++w) {
+      reachable[w] |= carMask[w];
+    }
+  }
+  for(idx_t w = 0; w < reachable.size(); ++w) {
+    reachable[w] &= unvisited[w];
+  }
+  ForEachMaskBit(reachable.data(), reachable.size(), [this, &profit](idx_t point) {
+    profit += in.Profits()[point];
+  });
+  return -profit;
+}
+
+void TOP_KnapsackBase::Update(const TOP_Node& n) {
+  idx_t words = MaskWords(n.in.Points());
+  if(in != &n.in) {
+    in = &n.in;
+    weights.assign(in->Points(), 0.0);
+    for(idx_t p = 0; p < in->Points(); ++p) {
+      dist_t first = numeric_limits<dist_t>::max(), second = numeric_limits<dist_t>::max();
+      if(in->NeighborsK() >= 2) { // Sorted by distance
+        first = in->Dist(p, in->Neighbors(p)[0]);
+        second = in->Dist(p, in->Neighbors(p)[1]);
+      } else {
+        for(idx_t q = 0; q < in->Points(); ++q) {
+          dist_t d = in->Dist(p, q);
+          if(q == p || d >= second) {
+            continue;
+          }
+          second = d < first ? first : d;
+          first = min(first, d);
+        }
+      }
+      weights[p] = (double(first) + double(second)) / 2;
+    }
+
+    order.clear();
+    for(idx_t p = 0; p < in->Points(); ++p) {
+      if(in->Profits()[p] > 0) {
+        order.push_back(p);
+      }
+    }
+    const int* profits = in->Profits();
+    stable_sort(order.begin(), order.end(), [this, profits](idx_t p1, idx_t p2) {
+      return profits[p1] * weights[p2] > profits[p2] * weights[p1]; // Decreasing profit / weight (also for 0 weights)
+    });
+
+    tails.assign(in->Cars(), -1); // No car has a mask
+    travels.assign(in->Cars(), 0);
+    changed.assign(in->Cars(), true);
+    masks.assign(in->Cars() * words, 0);
+  }
+
+  for(idx_t car = 0; car < in->Cars(); ++car) { // The mask depends only on the last point and on the travel distance
+    changed[car] = n.CarPoint(car) != tails[car] || n.TravelDist(car) != travels[car];
+    if(!changed[car]) {
       continue;
     }
-    // If can be reached by any car
-    for(idx_t car = 0; car < in.Cars(); ++car) {
-      if(SimulateMoveCar(car, point).feasible) {
-        profit += in.Point(point).Profit();
-        break;
+    tails[car] = n.CarPoint(car);
+    travels[car] = n.TravelDist(car);
+    uint64_t* mask = &masks[car * words];
+    if(n.ReachableUpdated(car)) {
+      copy(n.ReachableMask(car), n.ReachableMask(car) + words, mask);
+    } else {
+      in->DetourMaskDist(tails[car], in->EndPoint(), travels[car], in->MaxDist(), mask);
+    }
+  }
+}
+
+double TOP_KnapsackBase::Capacity(const TOP_Node& n, idx_t car) const {
+  // The travel distance includes the way back to the end from the last point, the slack covers the rounding of the sums
+  return double(in->MaxDist() - n.TravelDist(car) + in->Dist(n.CarPoint(car), in->EndPoint())) + 1e-9 * double(in->MaxDist());
+}
+
+double TOP_KnapsackBase::Fill(const std::vector<idx_t>& items, const uint64_t* filter, double capacity) const {
+  double profit = 0;
+  for(idx_t p : items) {
+    if(!((filter[p / 64] >> (p % 64)) & 1)) {
+      continue;
+    }
+    if(weights[p] > capacity) { // The fraction that fits
+      return profit + in->Profits()[p] * (capacity / weights[p]);
+    }
+    capacity -= weights[p];
+    profit += in->Profits()[p];
+  }
+  return profit;
+}
+
+int TOP_KnapsackBound::MaxProfit(const TOP_Node& n) {
+  Update(n);
+  idx_t words = MaskWords(in->Points());
+  const uint64_t* unvisited = n.UnvisitedMask();
+  reachable.assign(words, 0);
+  double capacity = 0;
+  for(idx_t car = 0; car < in->Cars(); ++car) {
+    const uint64_t* mask = Mask(car);
+    uint64_t any = 0;
+    for(idx_t w = 0; w < words; ++w) {
+      reachable[w] |= mask[w] & unvisited[w];
+      any |= mask[w] & unvisited[w];
+    }
+    if(any != 0) { // Only the cars that can still move
+      capacity += Capacity(n, car);
+    }
+  }
+  return n.PointProfit() + int(floor(Fill(order, reachable.data(), capacity) + 1e-6));
+}
+
+int TOP_EllipseBound::MaxProfit(const TOP_Node& n) {
+  Update(n);
+  carItems.resize(in->Cars());
+  double profit = 0;
+  for(idx_t car = 0; car < in->Cars(); ++car) {
+    if(changed[car]) { // The points of the new ellipse, in order
+      const uint64_t* mask = Mask(car);
+      carItems[car].clear();
+      for(idx_t p : order) {
+        if((mask[p / 64] >> (p % 64)) & 1) {
+          carItems[car].push_back(p);
+        }
       }
     }
+    profit += Fill(carItems[car], n.UnvisitedMask(), Capacity(n, car));
+  }
+  return n.PointProfit() + int(floor(profit + 1e-6));
+}
+
+bool TOP_StateTable::CheckAndAdd(const TOP_Node& n) {
+  if(memory == 0) {
+    return false;
+  }
+  idx_t cars = n.in.Cars();
+  size_t bucketSize = TOP_BT_TABLE_WAYS * (sizeof(Entry) + cars * sizeof(dist_t));
+  if(in != &n.in) { // First buckets in the memory, grown with the states
+    in = &n.in;
+    buckets = TOP_BT_TABLE_MIN_BUCKETS;
+    while(buckets > 1 && buckets * bucketSize > memory) {
+      buckets /= 2;
+    }
+    entries.assign(buckets * TOP_BT_TABLE_WAYS, Entry { 0, 0, 0, 0 });
+    travels.assign(entries.size() * cars, 0);
+    generation = 1;
+    used = 0;
+  }
+
+  uint64_t key = n.StateHash(0);
+  idx_t depth = n.in.Points() - n.UnvisitedCount();
+  size_t first = (key & (buckets - 1)) * TOP_BT_TABLE_WAYS;
+  ++clock;
+
+  size_t victim = first;
+  bool empty = false;
+  for(size_t e = first; e < first + TOP_BT_TABLE_WAYS; ++e) {
+    Entry& entry = entries[e];
+    if(entry.generation != generation) {
+      victim = e; // An empty entry is always taken
+      empty = true;
+      break;
+    }
+    if(entry.key == key) {
+      const dist_t* times = &travels[e * cars];
+      idx_t car = 0;
+      while(car < cars && n.TravelDist(car) == times[car]) {
+        ++car;
+      }
+      if(car == cars) { // Same state
+        entry.stamp = clock;
+        ++hits;
+        return true;
+      }
+    }
+    const Entry& old = entries[victim];
+    if(entry.depth > old.depth || (entry.depth == old.depth && entry.stamp < old.stamp)) {
+      victim = e;
+    }
+  }
+
+  entries[victim] = { key, generation, clock, depth };
+  for(idx_t car = 0; car < cars; ++car) {
+    travels[victim * cars + car] = n.TravelDist(car);
+  }
+  if(empty && ++used * 2 > entries.size() && buckets * 2 * bucketSize <= memory) {
+    Grow(cars);
+  }
+  return false;
+}
+
+void TOP_StateTable::Grow(idx_t cars) {
+  std::vector<Entry> oldEntries(buckets * 2 * TOP_BT_TABLE_WAYS, Entry { 0, 0, 0, 0 });
+  std::vector<dist_t> oldTravels(oldEntries.size() * cars, 0);
+  oldEntries.swap(entries);
+  oldTravels.swap(travels);
+  buckets *= 2;
+
+  // An old bucket is split in two new ones, its entries always fit
+  for(size_t o = 0; o < oldEntries.size(); ++o) {
+    if(oldEntries[o].generation != generation) {
+      continue;
+    }
+    size_t e = (oldEntries[o].key & (buckets - 1)) * TOP_BT_TABLE_WAYS;
+    while(entries[e].generation == generation) {
+      ++e;
+    }
+    entries[e] = oldEntries[o];
+    std::copy_n(&oldTravels[o * cars], cars, &travels[e * cars]);
   }
-  return -profit;
+}
+
+TOP_Checker::TOP_Checker() {
+  AddBound(std::make_unique<TOP_KnapsackBound>());
+  AddBound(std::make_unique<TOP_EllipseBound>());
+}
+
+TOP_Checker::TOP_Checker(const TOP_Checker& other) : BoundChecker(other), table(other.table) {
+  for(const auto& bound : other.bounds) {
+    bounds.push_back(bound->Clone());
+  }
+}
+
+TOP_Checker& TOP_Checker::operator=(const TOP_Checker& other) {
+  BoundChecker::operator=(other);
+  table = other.table;
+  bounds.clear();
+  for(const auto& bound : other.bounds) {
+    bounds.push_back(bound->Clone());
+  }
+  return *this;
 }
 
 NodeBound TOP_Checker::CheckNode(const TOP_Node& n) {
@@ -498,8 +666,14 @@ NodeBound TOP_Checker::CheckNode(const TOP_Node& n) {
     return NodeBound::NB_UnFeasible;
   }
   // Check highest score and return NonImproving...
-  if(n.GetMinCost() >= bestCost) {
-    //std::cerr << "NonImp " << n.GetMinCost() << std::endl;
+  cost_t boundCost = BoundCost();
+  for(const auto& bound : bounds) {
+    if(-bound->MaxProfit(n) >= boundCost) {
+      //std::cerr << "NonImp " << bound->MaxProfit(n) << std::endl;
+      return NodeBound::NB_NonImproving;
+    }
+  }
+  if(table.CheckAndAdd(n)) { // Same state already explored
     return NodeBound::NB_NonImproving;
   }
   //std::cerr << "Normal" << std::endl;
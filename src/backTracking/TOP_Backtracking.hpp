@@ -3,9 +3,30 @@
 
 #include "Backtracking.hpp"
 #include "../common/TOP_Data.hpp"
+#include "../common/TOP_Rating.hpp"
+
+#include <memory>
+#include <vector>
+#include <cstdint>
 
 typedef int cost_t;
 
+// Memory limit of the transposition table of a search in bytes, divided among the checkers of ParallelBacktrack
+// (0 to disable the table)
+#ifndef TOP_BT_TABLE_MEMORY
+#define TOP_BT_TABLE_MEMORY (32 << 20)
+#endif
+
+// Buckets of the transposition table at the first check, doubled while more than half of the entries are used
+#ifndef TOP_BT_TABLE_MIN_BUCKETS
+#define TOP_BT_TABLE_MIN_BUCKETS 64
+#endif
+
+// Entries of each bucket of the transposition table
+#ifndef TOP_BT_TABLE_WAYS
+#define TOP_BT_TABLE_WAYS 4
+#endif
+
 /******************
  * Implementation *
  ******************/
@@ -90,6 +111,26 @@ class TOP_Node : public Node<cost_t, TOP_NodeOutput>, public TOP_Output {
     cost_t GetMinCost() const;
 };
 
+/**
+ * Struct to better manage the choice into the branch tree: reppresent
+ * the couple of point (with its rating) and car choose in the GoToChild 
+ * or GoToParent moves 
+ */
+struct pointRating { 
+  idx_t point;
+  double rating;
+  idx_t car;
+};
+
+/**
+ * Scratch buffers of InsertPoint, owned by the walker and reused by all the calls
+ * (InsertPoint runs for every rated couple of every node)
+ */
+struct insertScratch {
+  std::vector<idx_t> inEllipse;
+  std::vector<uint64_t> ellipseMask;
+};
+
 /**
  * Class that represent the wallker along the tree of solutions, both partial and total ones. Because
  * of the prior non-knowledge og the lenght of one branch, the class is provided by various function
@@ -97,12 +138,25 @@ class TOP_Node : public Node<cost_t, TOP_NodeOutput>, public TOP_Output {
  */
 class TOP_Walker : public TreeWalker<TOP_Node> {
   public:
-    TOP_Walker(const TOP_Input& in, double wProfit, double wTime, double maxDeviation, double wNonCost, double nonGreedyDrop)
-      : TreeWalker(TOP_Node(in)), in(in), wProfit(wProfit), wTime(wTime), maxDeviation(maxDeviation), wNonCost(wNonCost), nonGreedyDrop(nonGreedyDrop) {} // Constructor
+    // Move of one level of the tree (for ParallelBacktrack): the point assigned to the car
+    struct Step {
+      idx_t car;
+      idx_t point;
+    };
+
+    // With granularK > 0 the children are chosen only among the granularK nearest neighbors of the last points of the cars,
+    // with carSymmetry the cars with the same last point and travel distance are moved only once
+    TOP_Walker(const TOP_Input& in, double wProfit, double wTime, double maxDeviation, double wNonCost, double nonGreedyDrop, idx_t granularK = 0, bool carSymmetry = true)
+      : TreeWalker(TOP_Node(in)), in(in), ratings(in), wProfit(wProfit), wTime(wTime), maxDeviation(maxDeviation), wNonCost(wNonCost), nonGreedyDrop(nonGreedyDrop),
+        granularK(std::min(granularK, in.NeighborsK())), carSymmetry(carSymmetry) {} // Constructor
 
     void GoToRoot() { // Empty solution  and Clear solution 
       current = TOP_Node(in); 
       carAssignmentOrder.clear();
+      pointAssignmentOrder.clear();
+      levelMarks.clear();
+      levelCursors.clear(); // The vectors of the levels are reused
+      ratings.Invalidate(); // The versions of the cars start again
     }
 
     // Walker functions
@@ -120,7 +174,8 @@ class TOP_Walker : public TreeWalker<TOP_Node> {
      * Walker function that allow to go the sibiling on at one level. In particular takes 
      * the current state of the problem and swap the current inserted node with the next 
      * point to its car. The sequence in which the couple is choosen is determinated by the 
-     * rating of the point.
+     * rating of the point: the vector generated by GoToChild for the level is reused (the
+     * parent state is the same for all the sibilings), so no rating is computed again.
      * 
      * @return true if there is one sibiling to go to, false otherwise and rollback to start the car
      */
@@ -135,26 +190,242 @@ class TOP_Walker : public TreeWalker<TOP_Node> {
      */
     bool GoToParent();
 
+    /**
+     * Moves from the root to the node of the current branch at depth
+     *
+     * @param depth depth of the node (at most the current depth)
+     * @return the moves, one for each level
+     */
+    std::vector<Step> Path(size_t depth) const;
+
+    /**
+     * Go to the node reached by a path returned by Path, replaying its moves from the root. The node and the
+     * following sibilings are the same ones visited by the walker that returned the path.
+     *
+     * @param path moves from the root
+     * @return [void]
+     */
+    void GoToPath(const std::vector<Step>& path);
+
   private:
     const TOP_Input& in;
     std::vector<idx_t> carAssignmentOrder;
+    std::vector<idx_t> pointAssignmentOrder; // Point assigned at each level (to the car of the level)
+    std::vector<TOP_Output::trail_t> levelMarks; // Undo trail mark of each level
+    std::vector<std::vector<pointRating>> levelRatings; // Couples of each level sorted by rating (the parent state is the same for all the sibilings)
+    std::vector<idx_t> levelCursors; // Index in levelRatings of the couple of each level
+    TOP_Ratings ratings; // Scratch buffers of the rating vectors
+    insertScratch scratch; // Scratch buffers of InsertPoint
     double wProfit;
     double wTime;
     double maxDeviation;
     double wNonCost;
     double nonGreedyDrop;
+    idx_t granularK; // Length of the candidate lists (0 for all the points)
+    bool carSymmetry; // Skip the cars symmetric to a previous one
+};
+
+/**
+ * Upper bound of the profit of the leaves under a node of the walker, used by TOP_Checker to prune. The
+ * nodes are checked in the order of the walk, so a bound can keep its state between two calls and update
+ * only the cars moved in between.
+ */
+class TOP_Bound {
+  public:
+    virtual ~TOP_Bound() {}
+
+    // Copy of the bound, with its state, for another checker
+    virtual std::unique_ptr<TOP_Bound> Clone() const = 0;
+
+    /**
+     * Maximum profit that the walker can reach from a node
+     *
+     * @param n node checked (feasible)
+     * @return upper bound of the profit of the leaves under n
+     */
+    virtual int MaxProfit(const TOP_Node& n) = 0;
+};
+
+/**
+ * Bound of TOP_Node::GetMinCost: the profit of all the points that at least one car can still reach
+ */
+class TOP_ReachableBound : public TOP_Bound {
+  public:
+    std::unique_ptr<TOP_Bound> Clone() const { return std::make_unique<TOP_ReachableBound>(*this); }
+    int MaxProfit(const TOP_Node& n) { return -n.GetMinCost(); }
+};
+
+/**
+ * Base of the knapsack bounds. A car that goes from its last point to the end through the points S travels at
+ * least the sum over S of half of the two shortest edges of each point (every point is entered and left once),
+ * so the points still collectable are the items of a knapsack with these weights and the remaining distance
+ * of the cars as capacity. The fractional knapsack is filled visiting the points by decreasing profit / weight,
+ * an order that depends only on the instance. The masks of the points reachable by each car are kept between
+ * the calls and rebuilt only for the cars whose last point or travel distance has changed.
+ */
+class TOP_KnapsackBase : public TOP_Bound {
+  protected:
+    const TOP_Input* in = nullptr; // Instance of the weights and of the order
+    std::vector<double> weights; // Half of the two shortest edges of each point
+    std::vector<idx_t> order; // Points with profit by decreasing profit / weight
+    std::vector<idx_t> tails; // Last point of each car when its mask was built
+    std::vector<dist_t> travels; // Travel distance of each car when its mask was built
+    std::vector<bool> changed; // Cars whose mask has been rebuilt by the last Update
+    std::vector<uint64_t> masks; // Points reachable by each car (MaskWords(in.Points()) words per car)
+
+    /**
+     * Bind the instance of n (the weights and the order are computed once) and rebuild the masks of the cars changed
+     *
+     * @param n node checked
+     * @return [void]
+     */
+    void Update(const TOP_Node& n);
+
+    // Distance that car can still travel from its last point to the end
+    double Capacity(const TOP_Node& n, idx_t car) const;
+
+    const uint64_t* Mask(idx_t car) const { return &masks[car * MaskWords(in->Points())]; }
+
+    /**
+     * Fill the fractional knapsack with the items in order
+     *
+     * @param items points in order of decreasing profit / weight
+     * @param filter only the items with the bit set are taken
+     * @param capacity capacity of the knapsack
+     * @return profit of the knapsack (with the fraction of the first item that does not fit)
+     */
+    double Fill(const std::vector<idx_t>& items, const uint64_t* filter, double capacity) const;
+};
+
+/**
+ * Fractional knapsack of all the cars together: the items are the points reachable by any car, the capacity is
+ * the sum of the remaining distances of the cars that can still move
+ */
+class TOP_KnapsackBound : public TOP_KnapsackBase {
+  public:
+    std::unique_ptr<TOP_Bound> Clone() const { return std::make_unique<TOP_KnapsackBound>(*this); }
+    int MaxProfit(const TOP_Node& n);
+
+  private:
+    std::vector<uint64_t> reachable; // Points not visited reachable by any car
 };
 
 /**
- * Class that represent the checker of the consistency of the current state
+ * Fractional knapsack of every car on its own ellipse (the points that it can still reach with its remaining
+ * distance), the bound is the sum over the cars. The items of each car are kept in order between the calls.
+ */
+class TOP_EllipseBound : public TOP_KnapsackBase {
+  public:
+    std::unique_ptr<TOP_Bound> Clone() const { return std::make_unique<TOP_EllipseBound>(*this); }
+    int MaxProfit(const TOP_Node& n);
+
+  private:
+    std::vector<std::vector<idx_t>> carItems; // Points in the ellipse of each car in knapsack order
+};
+
+/**
+ * Transposition table of the backtracking: the states already checked along the walk, identified by the visited
+ * points and the last point of each car (TOP_Output::StateHash) with the travel distance of every car. Different
+ * orders of the moves of the cars (the same routes built in another interleaving) reach the same state: the
+ * children of a node depend only on its state, so the subtree of a state reached again has already been
+ * explored (or proven not improving) from the first one, which cannot be an ancestor (every move visits a point).
+ * Only equal travel distances prune: with more travel the insertions, the ordering and the dedup of the couples
+ * change, so the subtree is not a part of the one explored.
+ * The table has a power of 2 buckets of TOP_BT_TABLE_WAYS entries, it starts from TOP_BT_TABLE_MIN_BUCKETS and it
+ * doubles while it fits the memory limit, then a full bucket replaces its deepest entry (the shallow states root
+ * the biggest subtrees), the least recently used one among the deepest.
+ */
+class TOP_StateTable {
+  public:
+    TOP_StateTable(std::size_t memory = TOP_BT_TABLE_MEMORY) : memory(memory) {}
+    TOP_StateTable(const TOP_StateTable& other) : memory(other.memory) {} // The states are of the walk of other, not copied
+    TOP_StateTable& operator=(const TOP_StateTable& other) {
+      SetMemory(other.memory);
+      return *this;
+    }
+
+    /**
+     * Return if the state of n has already been checked, otherwise add it
+     *
+     * @param n node checked
+     * @return true if the subtree of n does not need to be explored
+     */
+    bool CheckAndAdd(const TOP_Node& n);
+
+    // Remove all the states (the memory is kept)
+    void Clear() { ++generation; used = 0; }
+
+    // Change the memory limit in bytes (0 to disable the table), the states are removed
+    void SetMemory(std::size_t memory) {
+      this->memory = memory;
+      in = nullptr; // Allocated again at the next check
+      entries = {};
+      travels = {};
+    }
+    std::size_t Memory() const { return memory; }
+
+    // Number of repeated states found
+    std::size_t Hits() const { return hits; }
+
+  private:
+    struct Entry {
+      uint64_t key; // StateHash of the state
+      uint32_t generation; // Entry empty if different from the one of the table
+      uint32_t stamp; // Time of the last use
+      idx_t depth; // Points visited
+    };
+
+    void Grow(idx_t cars); // Double the buckets, moving the entries of the current generation
+
+    std::size_t memory;
+    const TOP_Input* in = nullptr; // Instance of the allocated entries
+    std::vector<Entry> entries; // TOP_BT_TABLE_WAYS consecutive entries for each bucket
+    std::vector<dist_t> travels; // Travel distances of the cars of each entry (back to back)
+    std::size_t buckets = 0;
+    std::size_t used = 0; // Entries of the current generation
+    uint32_t generation = 1;
+    uint32_t clock = 0;
+    std::size_t hits = 0;
+};
+
+/**
+ * Class that represent the checker of the consistency of the current state. The nodes are pruned by a list of
+ * bounds, by default the knapsack bound and the ellipse bound, and by the transposition table.
  */
 class TOP_Checker : public BoundChecker<TOP_Node> {
   public:
+    TOP_Checker();
+    TOP_Checker(const TOP_Checker& other); // The bounds are cloned
+    TOP_Checker& operator=(const TOP_Checker& other);
+
     void Reset() {
       bestCost = 0; // -profit
       bestNode = TOP_NodeOutput();
+      table.Clear();
     }
-    NodeBound CheckNode(const TOP_Node& n); // Check bounds and feasibility, can be used to update bounds
+    NodeBound CheckNode(const TOP_Node& n); // Check bounds and feasibility, can be used to update bounds (thread safe with a shared incumbent)
+
+    /**
+     * Add a bound to the list, the bounds are evaluated in order until one prunes the node
+     *
+     * @param bound bound to add
+     * @return [void]
+     */
+    void AddBound(std::unique_ptr<TOP_Bound> bound) { bounds.push_back(std::move(bound)); }
+
+    // Remove all the bounds (only the unfeasible nodes and the states already explored are pruned)
+    void ClearBounds() { bounds.clear(); }
+
+    // Divide the memory of the transposition table among the checkers of the workers
+    void SplitResources(int parts) { table.SetMemory(table.Memory() / parts); }
+
+    // Transposition table of the states checked (empty in the copies of the checker)
+    const TOP_StateTable& Table() const { return table; }
+    TOP_StateTable& Table() { return table; }
+
+  private:
+    std::vector<std::unique_ptr<TOP_Bound>> bounds;
+    TOP_StateTable table;
 };
 
 #endif
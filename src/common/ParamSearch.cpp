@@ -0,0 +1,203 @@
+#include "ParamSearch.hpp"
+
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+
+#include <ctpl_stl.h>
+
+using namespace std;
+
+ParamSearch::ParamSearch(vector<ParamDim> dims, int minDepth, int maxDepth) :
+  dims(std::move(dims)), minDepth(minDepth), maxDepth(maxDepth), eval(nullptr), pending(0), failed(false) {
+  if(this->dims.empty()) {
+    throw logic_error("ParamSearch needs at least one dimension");
+  }
+  if(maxDepth < 0 || maxDepth > 30 || minDepth > maxDepth) {
+    throw logic_error("ParamSearch depths must satisfy minDepth <= maxDepth <= 30");
+  }
+}
+
+ParamSearch::point_t ParamSearch::Point(const index_t& idx) const {
+  point_t point(dims.size());
+  for(size_t d = 0; d < dims.size(); ++d) {
+    point[d] = dims[d].min + idx[d] * (dims[d].max - dims[d].min) / (1 << maxDepth);
+  }
+  return point;
+}
+
+double ParamSearch::Value(const index_t& idx) {
+  promise<double> result;
+  shared_future<double> future;
+  bool owner = false;
+  {
+    lock_guard<mutex> lock(cacheMutex);
+    auto it = cache.find(idx);
+    if(it != cache.end()) {
+      future = it->second;
+    } else {
+      future = result.get_future().share();
+      cache.emplace(idx, future);
+      owner = true;
+    }
+  }
+  if(owner) {
+    try {
+      result.set_value((*eval)(Point(idx)));
+    } catch(...) {
+      result.set_exception(current_exception()); // Also for the workers waiting the point
+    }
+  }
+  return future.get();
+}
+
+vector<ParamSearch::cell_t> ParamSearch::Refine(const cell_t& cell) {
+  int nDims = dims.size();
+  int nCorners = 1 << nDims;
+  int half = 1 << (maxDepth - cell.depth - 1);
+
+  // Points of the cell with the step half: digit d of the code in base 3 is the step on dimension d
+  int nPoints = 1, centerCode = 0;
+  vector<int> pow3(nDims);
+  for(int d = 0; d < nDims; ++d) {
+    pow3[d] = nPoints;
+    centerCode += nPoints;
+    nPoints *= 3;
+  }
+  auto cornerCode = [&pow3, nDims](int k, int shift) {
+    int code = 0;
+    for(int d = 0; d < nDims; ++d) {
+      code += (((k >> d) & 1) + ((shift >> d) & 1)) * pow3[d];
+    }
+    return code;
+  };
+  auto pointIdx = [&cell, &pow3, nDims, half](int code) {
+    index_t idx(cell.lo);
+    for(int d = 0; d < nDims; ++d) {
+      idx[d] += half * (code / pow3[d] % 3);
+    }
+    return idx;
+  };
+
+  vector<double> values(nPoints);
+  vector<bool> known(nPoints, false);
+  for(int k = 0; k < nCorners; ++k) {
+    int code = 0;
+    for(int d = 0; d < nDims; ++d) {
+      code += 2 * ((k >> d) & 1) * pow3[d];
+    }
+    values[code] = cell.corners[k];
+    known[code] = true;
+  }
+  double center = values[centerCode] = Value(pointIdx(centerCode));
+  known[centerCode] = true;
+
+  for(int code = 0; code < nPoints; ++code) {
+    if(known[code]) {
+      continue;
+    }
+    // The point is flat with the center if a corner of its face has the value of the center
+    bool flat = false;
+    for(int k = 0; k < nCorners && !flat; ++k) {
+      bool onFace = true;
+      for(int d = 0; d < nDims && onFace; ++d) {
+        int digit = code / pow3[d] % 3;
+        onFace = digit == 1 || ((k >> d) & 1) == digit / 2;
+      }
+      flat = onFace && cell.corners[k] == center;
+    }
+    values[code] = flat ? center : Value(pointIdx(code));
+  }
+
+  vector<cell_t> subcells;
+  if(cell.depth + 1 >= maxDepth) {
+    return subcells; // The subcells have no middle points
+  }
+  for(int sub = 0; sub < nCorners; ++sub) {
+    cell_t subcell { pointIdx(cornerCode(0, sub)), cell.depth + 1, vector<double>(nCorners) };
+    for(int k = 0; k < nCorners; ++k) {
+      subcell.corners[k] = values[cornerCode(k, sub)];
+    }
+    bool uniform = all_of(subcell.corners.begin(), subcell.corners.end(), [&subcell](double v) { return v == subcell.corners[0]; });
+    if(subcell.depth < minDepth || !uniform) {
+      subcells.push_back(std::move(subcell));
+    }
+  }
+  return subcells;
+}
+
+void ParamSearch::Run(const eval_t& eval, int nThreads) {
+  this->eval = &eval;
+  cache.clear();
+  values.clear();
+  error = nullptr;
+  failed = false;
+  if(nThreads <= 0) {
+    nThreads = max(1U, thread::hardware_concurrency());
+  }
+
+  cell_t root { index_t(dims.size(), 0), 0, vector<double>(1 << dims.size()) };
+  for(size_t k = 0; k < root.corners.size(); ++k) {
+    index_t idx(dims.size());
+    for(size_t d = 0; d < dims.size(); ++d) {
+      idx[d] = ((k >> d) & 1) << maxDepth;
+    }
+    root.corners[k] = Value(idx);
+  }
+
+  if(maxDepth > 0) {
+    ctpl::thread_pool pool(nThreads);
+    function<void(const cell_t&)> solve = [this, &pool, &solve](const cell_t& cell) {
+      try {
+        if(!failed) {
+          for(auto& subcell : Refine(cell)) {
+            ++pending;
+            pool.push([&solve, subcell](int) { solve(subcell); });
+          }
+        }
+      } catch(...) {
+        lock_guard<mutex> lock(doneMutex);
+        if(!error) {
+          error = current_exception();
+        }
+        failed = true;
+      }
+      if(--pending == 0) {
+        lock_guard<mutex> lock(doneMutex);
+        done.notify_all();
+      }
+    };
+
+    pending = 1;
+    pool.push([&solve, &root](int) { solve(root); });
+    {
+      unique_lock<mutex> lock(doneMutex);
+      done.wait(lock, [this] { return pending == 0; });
+    }
+    pool.stop(true);
+  }
+
+  for(auto& [idx, future] : cache) {
+    try {
+      values[idx] = future.get();
+    } catch(...) {
+      // Reported by Run below
+    }
+  }
+  this->eval = nullptr;
+  if(error) {
+    rethrow_exception(error);
+  }
+}
+
+bool ParamSearch::Best(index_t& idx, double& value) const {
+  bool found = false;
+  for(const auto& [pointIdx, pointValue] : values) {
+    if(!found || pointValue > value) {
+      idx = pointIdx;
+      value = pointValue;
+      found = true;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,110 @@
+#ifndef PARAM_SEARCH_HPP
+#define PARAM_SEARCH_HPP
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <exception>
+
+/**
+ * One dimension of the parameter space searched by ParamSearch
+ */
+struct ParamDim {
+  std::string name;
+  double min, max;
+};
+
+/**
+ * Adaptive refinement of a box of parameters, the quadtree of ParamBisectionTest in N dimensions.
+ * The points are the indexes of a grid with 2^maxDepth steps on every dimension. For every cell (starting from the
+ * whole box) the center is evaluated and the points in the middle of its faces and edges take the value of the
+ * center when one of the corners of the same face has it (the region is assumed flat), the others are evaluated.
+ * The cells are split in 2^N subcells until maxDepth while the values of their corners differ (always until
+ * minDepth). Each point is evaluated at most once (the cache is shared by the workers) and the cells are solved
+ * by a pool of workers: when eval depends only on the point the results do not depend on the number of threads.
+ *
+ * Typical usage:
+ *   ParamSearch search({ { "wTime", 0.1, 1.5 }, { "maxDev", 0, 4 } }, 2, 6);
+ *   search.Run([&](const ParamSearch::point_t& x) { return Solve(x[0], x[1]); });
+ *   if(search.Best(idx, value)) { ... search.Point(idx) ... }
+ */
+class ParamSearch {
+  public:
+    typedef std::vector<int> index_t; // Position in the grid
+    typedef std::vector<double> point_t; // Values of the parameters
+    typedef std::function<double(const point_t&)> eval_t; // Value to maximize (called concurrently by the workers)
+
+    ParamSearch(std::vector<ParamDim> dims, int minDepth, int maxDepth);
+    ParamSearch(const ParamSearch&) = delete;
+    ParamSearch& operator=(const ParamSearch&) = delete;
+
+    /**
+     * Search the box, the values of the previous runs are discarded
+     *
+     * @param eval evaluation of a point (an exception stops the search and it is thrown again by Run)
+     * @param nThreads number of workers (0 for the hardware threads)
+     * @return [void]
+     */
+    void Run(const eval_t& eval, int nThreads = 0);
+
+    // Values of the parameters at a position of the grid
+    point_t Point(const index_t& idx) const;
+
+    const std::vector<ParamDim>& Dims() const { return dims; }
+
+    // Values of the points evaluated by the last run (the inferred ones are not included)
+    const std::map<index_t, double>& Values() const { return values; }
+
+    /**
+     * Best point evaluated by the last run, the ties are broken by the first position in index order
+     *
+     * @param idx position of the best point
+     * @param value value of the best point
+     * @return false if no point has been evaluated
+     */
+    bool Best(index_t& idx, double& value) const;
+
+  private:
+    struct cell_t {
+      index_t lo; // Corner with the lowest indexes
+      int depth; // The side is 2^(maxDepth - depth)
+      std::vector<double> corners; // Corner k is lo + side * (bit d of k) on dimension d
+    };
+
+    std::vector<ParamDim> dims;
+    int minDepth, maxDepth;
+
+    const eval_t* eval;
+    std::map<index_t, std::shared_future<double>> cache; // Points evaluated or being evaluated
+    std::mutex cacheMutex;
+    std::map<index_t, double> values;
+
+    std::atomic<long> pending; // Cells queued or being solved
+    std::mutex doneMutex;
+    std::condition_variable done;
+    std::exception_ptr error; // First exception thrown by eval (guarded by doneMutex)
+    std::atomic<bool> failed; // The cells are not refined anymore after an exception
+
+    /**
+     * Value of a point, evaluated by the first worker that asks it (the others wait for it)
+     *
+     * @param idx position of the point
+     * @return the value
+     */
+    double Value(const index_t& idx);
+
+    /**
+     * Evaluate the center and the middle points of a cell and return the subcells to refine
+     *
+     * @param cell cell with the corners known
+     * @return subcells to solve
+     */
+    std::vector<cell_t> Refine(const cell_t& cell);
+};
+
+#endif
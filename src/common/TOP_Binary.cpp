@@ -0,0 +1,326 @@
+#include "TOP_Binary.hpp"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static_assert(sizeof(TOP_BinaryHeader) == TOP_BINARY_ALIGN, "The header must fill the first section");
+
+#define TOP_BINARY_INPUT_MAGIC "TOPINST"
+#define TOP_BINARY_OUTPUT_MAGIC "TOPSOL"
+#define TOP_BINARY_HAS_DISTANCES 1
+#define TOP_BINARY_FIXED_POINT 2 // The table is in int32 with the scale in reserved
+
+#ifdef TOP_FIXED_POINT
+#define TOP_BINARY_DIST_FLAGS TOP_BINARY_FIXED_POINT
+#define TOP_BINARY_DIST_SCALE TOP_FIXED_POINT
+#else
+#define TOP_BINARY_DIST_FLAGS 0
+#define TOP_BINARY_DIST_SCALE 0
+#endif
+
+/**
+ * Read only memory mapping of a whole file, unmapped on destruction
+ */
+class MappedFile {
+  public:
+    MappedFile(const string& path) : data(nullptr), size(0) {
+      int fd = open(path.c_str(), O_RDONLY);
+      if(fd < 0) {
+        return;
+      }
+      struct stat st;
+      if(fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr != MAP_FAILED) {
+          data = static_cast<const char*>(addr);
+          size = st.st_size;
+        }
+      }
+      close(fd); // The mapping stays valid
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+      if(data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+      }
+    }
+
+    const char* data;
+    size_t size;
+};
+
+// Round a size to the alignment of the sections
+static size_t AlignSection(size_t size) {
+  return (size + TOP_BINARY_ALIGN - 1) / TOP_BINARY_ALIGN * TOP_BINARY_ALIGN;
+}
+
+// Size of an instance file with its sections
+static size_t InputFileSize(size_t nPoints, size_t stride) {
+  return sizeof(TOP_BinaryHeader) +
+    2 * AlignSection(nPoints * sizeof(double)) +
+    AlignSection(nPoints * sizeof(int32_t)) +
+    AlignSection(nPoints * stride * sizeof(dist_t));
+}
+
+// Size of a solution file with its sections
+static size_t OutputFileSize(size_t nCars, size_t nHops) {
+  return sizeof(TOP_BinaryHeader) +
+    AlignSection((nCars + 1) * sizeof(int32_t)) +
+    AlignSection(nHops * sizeof(int32_t));
+}
+
+/**
+ * Verify the header of a mapped file: magic, version, limits of the counts and size of the sections
+ *
+ * @param file mapped file
+ * @param magic expected magic string
+ * @return the header if valid, nullptr otherwise
+ */
+static const TOP_BinaryHeader* CheckHeader(const MappedFile& file, const char* magic) {
+  if(file.data == nullptr || file.size < sizeof(TOP_BinaryHeader)) {
+    return nullptr;
+  }
+  auto header = reinterpret_cast<const TOP_BinaryHeader*>(file.data);
+  if(strncmp(header->magic, magic, sizeof(header->magic)) != 0 ||
+     header->version != TOP_BINARY_VERSION || header->size != file.size) {
+    return nullptr;
+  }
+  if(header->points < 0 || header->points > TOP_BINARY_MAX_POINTS || header->cars < 0 || header->cars > TOP_BINARY_MAX_CARS) {
+    return nullptr;
+  }
+
+  size_t expected;
+  if(strcmp(magic, TOP_BINARY_INPUT_MAGIC) == 0) {
+    size_t nPoints = header->points;
+    bool hasTable = header->flags & TOP_BINARY_HAS_DISTANCES;
+    // The rows of the table are padded to the alignment, at most one section longer than the points
+    if(hasTable ? header->stride < nPoints || header->stride > nPoints + TOP_BINARY_ALIGN : header->stride != 0) {
+      return nullptr;
+    }
+    expected = InputFileSize(nPoints, header->stride);
+  } else {
+    if(header->hops < 0) {
+      return nullptr;
+    }
+    expected = OutputFileSize(header->cars, header->hops);
+  }
+  return expected == file.size ? header : nullptr;
+}
+
+/**
+ * Write a section padded to the alignment
+ *
+ * @param os stream to write
+ * @param data section content
+ * @param size section size in bytes
+ * @return [void]
+ */
+static void WriteSection(ostream& os, const void* data, size_t size) {
+  static const char zeros[TOP_BINARY_ALIGN] = {};
+  os.write(static_cast<const char*>(data), size);
+  os.write(zeros, AlignSection(size) - size);
+}
+
+#pragma region TOP_Input
+
+void WriteBinary(const string& path, const TOP_Input& in, bool withDistances) {
+  size_t nPoints = in.Points();
+  withDistances = withDistances && in.HasDistanceTable();
+
+  TOP_BinaryHeader header = {};
+  strncpy(header.magic, TOP_BINARY_INPUT_MAGIC, sizeof(header.magic));
+  header.version = TOP_BINARY_VERSION;
+  header.flags = withDistances ? TOP_BINARY_HAS_DISTANCES | TOP_BINARY_DIST_FLAGS : 0;
+  header.points = nPoints;
+  header.cars = in.Cars();
+  header.max_time = in.MaxTime();
+  header.stride = withDistances ? in.distances_stride : 0;
+  header.reserved = withDistances ? TOP_BINARY_DIST_SCALE : 0;
+  header.size = InputFileSize(nPoints, header.stride);
+
+  ofstream os(path, ios::binary);
+  if(!os) {
+    throw runtime_error("Unable to write the binary instance " + path);
+  }
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  WriteSection(os, in.Xs(), nPoints * sizeof(double));
+  WriteSection(os, in.Ys(), nPoints * sizeof(double));
+  WriteSection(os, in.Profits(), nPoints * sizeof(int32_t));
+  WriteSection(os, in.distances.data(), nPoints * header.stride * sizeof(dist_t));
+}
+
+bool ReadBinary(const string& path, TOP_Input& in) {
+  MappedFile file(path);
+  auto header = CheckHeader(file, TOP_BINARY_INPUT_MAGIC);
+  if(header == nullptr) {
+    return false;
+  }
+
+  size_t nPoints = header->points;
+  const char* section = file.data + sizeof(TOP_BinaryHeader);
+  auto xs = reinterpret_cast<const double*>(section);
+  section += AlignSection(nPoints * sizeof(double));
+  auto ys = reinterpret_cast<const double*>(section);
+  section += AlignSection(nPoints * sizeof(double));
+  auto profits = reinterpret_cast<const int32_t*>(section);
+  section += AlignSection(nPoints * sizeof(int32_t));
+  auto distances = reinterpret_cast<const dist_t*>(section);
+
+  in.Clear();
+  in.cars = header->cars;
+  in.max_time = header->max_time;
+  in.points.resize(nPoints);
+  for(size_t i = 0; i < nPoints; ++i) {
+    in.points[i].Set(xs[i], ys[i], profits[i]);
+  }
+  in.ComputeArrays();
+  in.ComputeMaxDist();
+
+  // Copy the table when it has the same type and layout of the one computed by ComputeDistances
+  constexpr idx_t rowAlign = CACHE_LINE_SIZE / sizeof(dist_t);
+  idx_t stride = (nPoints + rowAlign - 1) / rowAlign * rowAlign;
+  bool sameType = (header->flags & TOP_BINARY_FIXED_POINT) == TOP_BINARY_DIST_FLAGS && header->reserved == TOP_BINARY_DIST_SCALE;
+  if((header->flags & TOP_BINARY_HAS_DISTANCES) && sameType && header->stride == stride && nPoints <= DISTANCE_TABLE_MAX_POINTS) {
+    in.distances.assign(distances, distances + nPoints * stride);
+    in.distances_stride = stride;
+  } else {
+    in.ComputeDistances();
+  }
+
+  if(nPoints >= GRID_MIN_POINTS) {
+    in.grid.Build(in.Xs(), in.Ys(), nPoints);
+  }
+  in.ComputeNeighbors(TOP_NEIGHBORS_K);
+  return true;
+}
+
+#pragma endregion
+
+#pragma region TOP_Output
+
+void WriteBinary(const string& path, const TOP_Output& out) {
+  const TOP_Input& in = out.in;
+  vector<int32_t> carStart(in.Cars() + 1, 0), dests;
+  for(idx_t car = 0; car < in.Cars(); ++car) {
+    for(idx_t hop = 1; hop < out.Hops(car); ++hop) {
+      dests.push_back(out.Hop(car, hop));
+    }
+    carStart[car + 1] = dests.size();
+  }
+
+  TOP_BinaryHeader header = {};
+  strncpy(header.magic, TOP_BINARY_OUTPUT_MAGIC, sizeof(header.magic));
+  header.version = TOP_BINARY_VERSION;
+  header.points = in.Points();
+  header.cars = in.Cars();
+  header.max_time = in.MaxTime();
+  header.hops = dests.size();
+  header.size = OutputFileSize(in.Cars(), dests.size());
+
+  ofstream os(path, ios::binary);
+  if(!os) {
+    throw runtime_error("Unable to write the binary solution " + path);
+  }
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  WriteSection(os, carStart.data(), carStart.size() * sizeof(int32_t));
+  WriteSection(os, dests.data(), dests.size() * sizeof(int32_t));
+}
+
+bool ReadBinary(const string& path, TOP_Output& out) {
+  MappedFile file(path);
+  auto header = CheckHeader(file, TOP_BINARY_OUTPUT_MAGIC);
+  if(header == nullptr) {
+    return false;
+  }
+  if(header->cars != out.in.Cars() || header->points != out.in.Points()) {
+    return false; // Solution of another input (i.e. a stale file), the text is read instead
+  }
+
+  auto carStart = reinterpret_cast<const int32_t*>(file.data + sizeof(TOP_BinaryHeader));
+  auto dests = reinterpret_cast<const int32_t*>(file.data + sizeof(TOP_BinaryHeader) + AlignSection((header->cars + 1) * sizeof(int32_t)));
+
+  // The routes must be consecutive slices of dests and visit points of the input
+  if(carStart[0] != 0 || carStart[header->cars] != header->hops) {
+    return false;
+  }
+  for(idx_t car = 0; car < header->cars; ++car) {
+    if(carStart[car + 1] < carStart[car]) {
+      return false;
+    }
+  }
+  for(idx_t i = 0; i < header->hops; ++i) {
+    if(dests[i] < 0 || dests[i] >= out.in.Points()) {
+      return false;
+    }
+  }
+
+  out.Clear();
+  for(idx_t car = 0; car < header->cars; ++car) {
+    for(idx_t i = carStart[car]; i < carStart[car + 1]; ++i) {
+      out.MoveCar(car, dests[i]);
+    }
+  }
+  return true;
+}
+
+#pragma endregion
+
+#pragma region Loading
+
+/**
+ * Return the binary version of a text file if it exists and it is up to date
+ *
+ * @param path text file
+ * @param ext extension of the binary file
+ * @return the path of the binary file, empty if it cannot be used
+ */
+static string UpToDateBinary(const string& path, const char* ext) {
+  error_code ec;
+  fs::path binPath = fs::path(path).replace_extension(ext);
+  if(!fs::exists(binPath, ec)) {
+    return "";
+  }
+  if(fs::exists(path, ec) && fs::last_write_time(binPath, ec) < fs::last_write_time(path, ec)) {
+    return ""; // The text has been modified after the conversion
+  }
+  return binPath.string();
+}
+
+bool LoadInput(const string& path, TOP_Input& in) {
+  string binPath = UpToDateBinary(path, TOP_BINARY_INPUT_EXT);
+  if(!binPath.empty() && ReadBinary(binPath, in)) {
+    return true;
+  }
+  ifstream is(path);
+  if(!is) {
+    return false;
+  }
+  is >> in;
+  return true;
+}
+
+bool LoadOutput(const string& path, TOP_Output& out) {
+  string binPath = UpToDateBinary(path, TOP_BINARY_OUTPUT_EXT);
+  if(!binPath.empty() && ReadBinary(binPath, out)) {
+    return true;
+  }
+  ifstream is(path);
+  if(!is) {
+    return false;
+  }
+  is >> out;
+  return true;
+}
+
+#pragma endregion
@@ -0,0 +1,113 @@
+#ifndef TOP_BINARY_HPP
+#define TOP_BINARY_HPP
+
+#include "TOP_Data.hpp"
+
+#include <string>
+#include <cstdint>
+
+// Version of the binary files, files of other versions are ignored (the text is read instead)
+#define TOP_BINARY_VERSION 1
+
+// Extensions of the binary files, saved next to the text ones (instances/p1.2.a.txt -> instances/p1.2.a.topb)
+#define TOP_BINARY_INPUT_EXT ".topb"
+#define TOP_BINARY_OUTPUT_EXT ".outb"
+
+// Alignment of the sections inside the binary files
+#define TOP_BINARY_ALIGN CACHE_LINE_SIZE
+
+// Limits of the headers accepted by the readers, larger values are taken as corrupt files
+#define TOP_BINARY_MAX_POINTS (1 << 24)
+#define TOP_BINARY_MAX_CARS (1 << 16)
+
+/**
+ * Binary format (native endianness, every section starts at a multiple of TOP_BINARY_ALIGN):
+ *  Instance:
+ *    {TOP_BinaryHeader} magic "TOPINST"
+ *    {double x[Points]}
+ *    {double y[Points]}
+ *    {int32 profit[Points]}
+ *    {dist_t distances[Points][stride]} (optional, same type and layout of the table of TOP_Input,
+ *                                         int32 scaled by reserved when built with TOP_FIXED_POINT)
+ *
+ *  Solution: (start and end points are implicit)
+ *    {TOP_BinaryHeader} magic "TOPSOL"
+ *    {int32 car_start[Cars + 1]} route of car is dest[car_start[car]:car_start[car + 1]]
+ *    {int32 dest[Hops]}
+ *
+ * The files are read with mmap and the sections are copied as they are, without any parsing. The readers
+ * check that the header is within the limits above and that the size of the file is the one of its sections.
+ */
+struct TOP_BinaryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  int32_t points;
+  int32_t cars;
+  double max_time;
+  uint64_t stride; // Row length of the distance table (0 if not saved)
+  int32_t hops;
+  int32_t reserved; // Scale of the fixed point distance table (0 if double)
+  uint64_t size; // Size of the whole file
+  uint8_t padding[8];
+};
+
+/**
+ * Write the instance in the binary format
+ *
+ * @param path file to write
+ * @param in input to save
+ * @param withDistances save also the distance table (when the input has it)
+ * @return [void]
+ */
+void WriteBinary(const std::string& path, const TOP_Input& in, bool withDistances = true);
+
+/**
+ * Read an instance in the binary format
+ *
+ * @param path file to read
+ * @param in input that is overwritten
+ * @return false if the file cannot be mapped or it is not a valid file of the current version
+ */
+bool ReadBinary(const std::string& path, TOP_Input& in);
+
+/**
+ * Write the solution in the binary format
+ *
+ * @param path file to write
+ * @param out output to save
+ * @return [void]
+ */
+void WriteBinary(const std::string& path, const TOP_Output& out);
+
+/**
+ * Read a solution in the binary format, the routes are replayed on out
+ *
+ * @param path file to read
+ * @param out output that is overwritten (its input must match the one of the file)
+ * @return false if the file cannot be mapped or it is not a valid file of the current version (also when the
+ *         routes are corrupt or the input does not match, out is not changed)
+ */
+bool ReadBinary(const std::string& path, TOP_Output& out);
+
+/**
+ * Read the instance from a text file, or from its binary version (same name with TOP_BINARY_INPUT_EXT)
+ * when it exists and it is not older than the text
+ *
+ * @param path text file of the instance
+ * @param in input that is overwritten
+ * @return false if neither of the files can be read
+ */
+bool LoadInput(const std::string& path, TOP_Input& in);
+
+/**
+ * Read the solution from a text file, or from its binary version (same name with TOP_BINARY_OUTPUT_EXT)
+ * when it exists and it is not older than the text
+ *
+ * @param path text file of the solution
+ * @param out output that is overwritten
+ * @return false if neither of the files can be read
+ */
+bool LoadOutput(const std::string& path, TOP_Output& out);
+
+#endif
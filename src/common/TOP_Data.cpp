@@ -1,6 +1,13 @@
 #include "TOP_Data.hpp"
 
 #include <fstream>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -38,6 +45,66 @@ istream& operator>>(istream& is, TOP_Point& p) {
 
 #pragma endregion
 
+#pragma region SIMD
+
+// Minimal wrappers on the vector instructions used by the batch kernels
+// (SIMD_DOUBLES lanes, loads are aligned because the arrays are aligned to a cache line)
+#if defined(__AVX2__)
+#define SIMD_DOUBLES 4
+typedef __m256d vdouble;
+static inline vdouble vload(const double* p) { return _mm256_load_pd(p); }
+static inline void vstore(double* p, vdouble a) { _mm256_storeu_pd(p, a); }
+static inline vdouble vset1(double x) { return _mm256_set1_pd(x); }
+static inline vdouble vadd(vdouble a, vdouble b) { return _mm256_add_pd(a, b); }
+static inline vdouble vsub(vdouble a, vdouble b) { return _mm256_sub_pd(a, b); }
+static inline vdouble vmul(vdouble a, vdouble b) { return _mm256_mul_pd(a, b); }
+static inline vdouble vsqrt(vdouble a) { return _mm256_sqrt_pd(a); }
+static inline uint64_t vmaskle(vdouble a, vdouble b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ)); }
+#elif defined(__SSE2__)
+#define SIMD_DOUBLES 2
+typedef __m128d vdouble;
+static inline vdouble vload(const double* p) { return _mm_load_pd(p); }
+static inline void vstore(double* p, vdouble a) { _mm_storeu_pd(p, a); }
+static inline vdouble vset1(double x) { return _mm_set1_pd(x); }
+static inline vdouble vadd(vdouble a, vdouble b) { return _mm_add_pd(a, b); }
+static inline vdouble vsub(vdouble a, vdouble b) { return _mm_sub_pd(a, b); }
+static inline vdouble vmul(vdouble a, vdouble b) { return _mm_mul_pd(a, b); }
+static inline vdouble vsqrt(vdouble a) { return _mm_sqrt_pd(a); }
+static inline uint64_t vmaskle(vdouble a, vdouble b) { return _mm_movemask_pd(_mm_cmple_pd(a, b)); }
+#else
+#define SIMD_DOUBLES 1 // Scalar fallback only
+#endif
+
+// Same for the int32 distances of the fixed point mode (SIMD_INTS lanes)
+#if defined(__AVX2__)
+#define SIMD_INTS 8
+typedef __m256i vint;
+static inline vint viload(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+static inline vint viset1(int32_t x) { return _mm256_set1_epi32(x); }
+static inline vint viadd(vint a, vint b) { return _mm256_add_epi32(a, b); }
+static inline uint64_t vimaskle(vint a, vint b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b))) ^ 0xFF; }
+#elif defined(__SSE2__)
+#define SIMD_INTS 4
+typedef __m128i vint;
+static inline vint viload(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+static inline vint viset1(int32_t x) { return _mm_set1_epi32(x); }
+static inline vint viadd(vint a, vint b) { return _mm_add_epi32(a, b); }
+static inline uint64_t vimaskle(vint a, vint b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b))) ^ 0xF; }
+#else
+#define SIMD_INTS 1
+#endif
+
+#if SIMD_DOUBLES > 1
+// Distance from (px, py) to the SIMD_DOUBLES points starting at i, same operations of TOP_Point::Distance
+static inline vdouble vdistance(vdouble px, vdouble py, const double* xs, const double* ys, idx_t i) {
+  vdouble dx = vsub(px, vload(xs + i));
+  vdouble dy = vsub(py, vload(ys + i));
+  return vsqrt(vadd(vmul(dx, dx), vmul(dy, dy)));
+}
+#endif
+
+#pragma endregion
+
 #pragma region TOP_Input
 
 /**
@@ -61,7 +128,217 @@ TOP_Input::TOP_Input(const std::string& filename) {
 void TOP_Input::Clear() {
   cars = 0;
   max_time = 0;
+  max_dist = 0;
   points.clear();
+  xs.clear();
+  ys.clear();
+  profits.clear();
+  distances.clear();
+  distances_stride = 0;
+  grid.Clear();
+  neighbors.clear();
+  neighbors_k = 0;
+}
+
+/**
+ * Fill the structure of arrays mirror of the points, padded with zeros up to a cache line
+ * so that the kernels can always use aligned loads
+ *
+ * @return [void]
+ */
+void TOP_Input::ComputeArrays() {
+  constexpr idx_t padAlign = CACHE_LINE_SIZE / sizeof(double);
+  idx_t padded = (points.size() + padAlign - 1) / padAlign * padAlign;
+  xs.assign(padded, 0.0);
+  ys.assign(padded, 0.0);
+  profits.assign(padded, 0);
+  for(idx_t i = 0; i < points.size(); ++i) {
+    xs[i] = points[i].X();
+    ys[i] = points[i].Y();
+    profits[i] = points[i].Profit();
+  }
+}
+
+/**
+ * Precompute the symmetric table of the distances between all the points, unless the
+ * instance is bigger than DISTANCE_TABLE_MAX_POINTS (then Distance computes them on the fly).
+ * Requires the arrays of ComputeArrays, each row is filled by DistancesFrom.
+ *
+ * @return [void]
+ */
+void TOP_Input::ComputeDistances() {
+  distances.clear();
+  distances_stride = 0;
+  idx_t nPoints = points.size();
+  if(nPoints > DISTANCE_TABLE_MAX_POINTS) {
+    return;
+  }
+
+  constexpr idx_t rowAlign = CACHE_LINE_SIZE / sizeof(dist_t); // Each row starts on a cache line
+  distances_stride = (nPoints + rowAlign - 1) / rowAlign * rowAlign;
+  distances.assign((size_t)nPoints * distances_stride, 0);
+#ifdef TOP_FIXED_POINT
+  vector<double> row(nPoints);
+  for(idx_t p1 = 0; p1 < nPoints; ++p1) {
+    DistancesFrom(p1, row.data());
+    transform(row.begin(), row.end(), &distances[p1 * distances_stride], ToDist);
+  }
+#else
+  for(idx_t p1 = 0; p1 < nPoints; ++p1) {
+    DistancesFrom(p1, &distances[p1 * distances_stride]);
+  }
+#endif
+}
+
+/**
+ * Compute the maximum travel time in the storage type of the distances (rounded down in
+ * fixed point). In fixed point verify also that the sums of the distances fit in an int32.
+ *
+ * @return [void]
+ */
+void TOP_Input::ComputeMaxDist() {
+#ifdef TOP_FIXED_POINT
+  double maxCoord = 0.0; // The distances are at most the diagonal of the bounding box
+  for(const auto& p : points) {
+    maxCoord = max({ maxCoord, abs(p.X()), abs(p.Y()) });
+  }
+  if(max_time * TOP_FIXED_POINT > INT32_MAX / 4 || 3 * maxCoord * TOP_FIXED_POINT > INT32_MAX / 4) {
+    throw runtime_error("The instance is too large for the scale of TOP_FIXED_POINT");
+  }
+  max_dist = (dist_t)floor(max_time * TOP_FIXED_POINT);
+#else
+  max_dist = max_time;
+#endif
+}
+
+void TOP_Input::DistancesFrom(idx_t p, double* dist) const {
+  idx_t nPoints = points.size();
+  idx_t i = 0;
+#if SIMD_DOUBLES > 1
+  vdouble px = vset1(xs[p]), py = vset1(ys[p]);
+  for(; i + SIMD_DOUBLES <= nPoints; i += SIMD_DOUBLES) {
+    vstore(dist + i, vdistance(px, py, Xs(), Ys(), i));
+  }
+#endif
+  for(; i < nPoints; ++i) { // Tail
+    dist[i] = points[p].Distance(points[i]);
+  }
+}
+
+void TOP_Input::ExtraDistances(idx_t pStart, idx_t pEnd, double* extra) const {
+  idx_t nPoints = points.size();
+  double direct = Distance(pStart, pEnd);
+  idx_t i = 0;
+#if SIMD_DOUBLES > 1
+  vdouble sx = vset1(xs[pStart]), sy = vset1(ys[pStart]);
+  vdouble ex = vset1(xs[pEnd]), ey = vset1(ys[pEnd]);
+  vdouble vdirect = vset1(direct);
+  for(; i + SIMD_DOUBLES <= nPoints; i += SIMD_DOUBLES) {
+    vdouble d = vadd(vdistance(sx, sy, Xs(), Ys(), i), vdistance(ex, ey, Xs(), Ys(), i));
+    vstore(extra + i, vsub(d, vdirect));
+  }
+#endif
+  for(; i < nPoints; ++i) { // Tail
+    extra[i] = points[pStart].Distance(points[i]) + points[i].Distance(points[pEnd]) - direct;
+  }
+}
+
+void TOP_Input::DetourMask(idx_t pStart, idx_t pEnd, double base, double limit, uint64_t* mask) const {
+  idx_t nPoints = points.size();
+  double direct = Distance(pStart, pEnd);
+  std::fill(mask, mask + MaskWords(nPoints), 0);
+  if(grid.Selective(direct, base, limit)) { // Only the cells near the ellipse
+    grid.EllipseQuery(xs[pStart], ys[pStart], xs[pEnd], ys[pEnd], direct, base, limit, [](idx_t) { return false; }, [mask](idx_t q) {
+      mask[q / 64] |= uint64_t(1) << (q % 64);
+    });
+    return;
+  }
+  idx_t i = 0;
+#if SIMD_DOUBLES > 1
+  vdouble sx = vset1(xs[pStart]), sy = vset1(ys[pStart]);
+  vdouble ex = vset1(xs[pEnd]), ey = vset1(ys[pEnd]);
+  vdouble vdirect = vset1(direct), vbase = vset1(base), vlimit = vset1(limit);
+  for(; i + SIMD_DOUBLES <= nPoints; i += SIMD_DOUBLES) {
+    vdouble d = vsub(vadd(vdistance(sx, sy, Xs(), Ys(), i), vdistance(ex, ey, Xs(), Ys(), i)), vdirect);
+    mask[i / 64] |= vmaskle(vadd(d, vbase), vlimit) << (i % 64);
+  }
+#endif
+  for(; i < nPoints; ++i) { // Tail
+    double d = points[pStart].Distance(points[i]) + points[i].Distance(points[pEnd]) - direct;
+    if(d + base <= limit) {
+      mask[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+}
+
+void TOP_Input::DetourMaskDist(idx_t pStart, idx_t pEnd, dist_t base, dist_t limit, uint64_t* mask) const {
+#ifdef TOP_FIXED_POINT
+  idx_t nPoints = points.size();
+  std::fill(mask, mask + MaskWords(nPoints), 0);
+  if(distances.empty()) { // Distances computed on the fly
+    for(idx_t q = 0; q < nPoints; ++q) {
+      if(base + ExtraDist(pStart, q, pEnd) <= limit) {
+        mask[q / 64] |= uint64_t(1) << (q % 64);
+      }
+    }
+    return;
+  }
+
+  // base + d(s, q) + d(q, e) - d(s, e) <= limit is exact in integers
+  const dist_t* rowStart = &distances[pStart * distances_stride];
+  const dist_t* rowEnd = &distances[pEnd * distances_stride];
+  dist_t bound = limit - base + Dist(pStart, pEnd);
+  idx_t i = 0;
+#if SIMD_INTS > 1
+  vint vbound = viset1(bound);
+  for(; i + SIMD_INTS <= nPoints; i += SIMD_INTS) {
+    mask[i / 64] |= vimaskle(viadd(viload(rowStart + i), viload(rowEnd + i)), vbound) << (i % 64);
+  }
+#endif
+  for(; i < nPoints; ++i) { // Tail
+    if(rowStart[i] + rowEnd[i] <= bound) {
+      mask[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+#else
+  DetourMask(pStart, pEnd, base, limit, mask);
+#endif
+}
+
+void TOP_Input::ComputeNeighbors(idx_t k) {
+  idx_t nPoints = points.size();
+  neighbors.clear();
+  neighbors_k = 0;
+  k = min(k, nPoints - 1);
+  if(k <= 0) {
+    return;
+  }
+
+  neighbors.resize(nPoints * k);
+  neighbors_k = k;
+  vector<pair<double, idx_t>> found;
+  vector<pair<dist_t, idx_t>> candidates;
+  for(idx_t p = 0; p < nPoints; ++p) {
+    candidates.clear();
+    if(!grid.Empty()) { // Only the cells around p
+      grid.Nearest(xs[p], ys[p], k, p, found);
+      for(auto& [_, q] : found) {
+        candidates.emplace_back(Dist(p, q), q);
+      }
+    } else {
+      for(idx_t q = 0; q < nPoints; ++q) {
+        if(q != p) {
+          candidates.emplace_back(Dist(p, q), q);
+        }
+      }
+      nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end());
+      candidates.resize(k);
+    }
+    sort(candidates.begin(), candidates.end()); // Same order in fixed point
+    for(idx_t i = 0; i < k; ++i) {
+      neighbors[p * k + i] = candidates[i].second;
+    }
+  }
 }
 
 // IO
@@ -84,6 +361,13 @@ istream& operator>>(istream& is, TOP_Input& in) {
     is >> p;
     in.points[i] = p;
   }
+  in.ComputeArrays();
+  in.ComputeDistances();
+  in.ComputeMaxDist();
+  if(nPoints >= GRID_MIN_POINTS) {
+    in.grid.Build(in.Xs(), in.Ys(), nPoints);
+  }
+  in.ComputeNeighbors(TOP_NEIGHBORS_K);
   return is;
 }
 
@@ -116,7 +400,66 @@ ostream& operator<<(ostream& os, const TOP_Input& in) {
  * @return true if they are equal, false otherwise
  */
 bool operator==(const TOP_Output& out1, const TOP_Output& out2) {
-  return out1.in == out2.in && out1.car_hops == out2.car_hops;
+  return &out1.in == &out2.in && out1.car_start == out2.car_start && out1.hops == out2.hops;
+}
+
+/**
+ * Copy an output of the same input, the vectors keep their capacity so
+ * no allocation is done after the first copy
+ *
+ * @param out output to copy
+ * @return this output
+ */
+TOP_Output& TOP_Output::operator=(const TOP_Output& out) {
+  if(&in != &out.in) {
+    throw logic_error("Cannot assign an output of a different input");
+  }
+  hops = out.hops;
+  car_start = out.car_start;
+  visited = out.visited;
+  unvisited_mask = out.unvisited_mask;
+  unvisited_profit = out.unvisited_profit;
+  unvisited_count = out.unvisited_count;
+  unvisited_hash = out.unvisited_hash;
+  travel_time = out.travel_time;
+  point_profit = out.point_profit;
+  time_violations = out.time_violations;
+  car_version = out.car_version;
+  last_version = out.last_version;
+  reachable = out.reachable;
+  reachable_version = out.reachable_version;
+  trail.clear(); // The trail refers to the previous state
+  trail_marks = 0;
+  return *this;
+}
+
+/**
+ * Move an output of the same input, the buffers are stolen from out
+ *
+ * @param out output to move
+ * @return this output
+ */
+TOP_Output& TOP_Output::operator=(TOP_Output&& out) {
+  if(&in != &out.in) {
+    throw logic_error("Cannot assign an output of a different input");
+  }
+  hops = std::move(out.hops);
+  car_start = std::move(out.car_start);
+  visited = std::move(out.visited);
+  unvisited_mask = std::move(out.unvisited_mask);
+  unvisited_profit = out.unvisited_profit;
+  unvisited_count = out.unvisited_count;
+  unvisited_hash = out.unvisited_hash;
+  travel_time = std::move(out.travel_time);
+  point_profit = out.point_profit;
+  time_violations = out.time_violations;
+  car_version = std::move(out.car_version);
+  last_version = out.last_version;
+  reachable = std::move(out.reachable);
+  reachable_version = std::move(out.reachable_version);
+  trail = std::move(out.trail);
+  trail_marks = out.trail_marks;
+  return *this;
 }
 
 /**
@@ -129,19 +472,32 @@ void TOP_Output::Clear() {
   visited[in.StartPoint()] += in.Cars();
   visited[in.EndPoint()] += in.Cars();
 
-  for(idx_t car = 0; car < in.Cars(); ++car) { // Clear the car
-    car_hops[car].clear();
+  fill(unvisited_mask.begin(), unvisited_mask.end(), 0); // Clear the unvisited aggregates
+  unvisited_profit = 0;
+  unvisited_count = 0;
+  unvisited_hash = 0;
+  for(idx_t point = 0; point < in.Points(); ++point) {
+    UpdateUnvisited(point, true, visited[point] > 0);
   }
 
-  double zeroTravelTime = in.Point(in.StartPoint()).Distance(in.Point(in.EndPoint())); // Clear the travel time
+  hops.clear(); // Clear the cars
+  fill(car_start.begin(), car_start.end(), 0);
+
+  dist_t zeroTravelTime = in.Dist(in.StartPoint(), in.EndPoint()); // Clear the travel time
   fill(travel_time.begin(), travel_time.end(), zeroTravelTime);
+  for(idx_t car = 0; car < in.Cars(); ++car) { // The reachability masks are outdated
+    car_version[car] = ++last_version;
+  }
 
   point_profit = in.Point(in.StartPoint()).Profit(); // Clear the profit
   if(in.EndPoint() != in.StartPoint()) {
     point_profit = in.Point(in.EndPoint()).Profit();
   }
 
-  time_violations = zeroTravelTime > in.MaxTime() ? in.Cars() : 0; // Clear the time violations (or set them all if impossible)
+  time_violations = zeroTravelTime > in.MaxDist() ? in.Cars() : 0; // Clear the time violations (or set them all if impossible)
+
+  trail.clear(); // Clear the undo trail
+  trail_marks = 0;
 }
 
 /**
@@ -156,9 +512,11 @@ void TOP_Output::Clear() {
 const TOP_Output::SimulateMoveCarResult TOP_Output::MoveCar(idx_t car, idx_t dest, bool force) {
   const auto res = SimulateMoveCar(car, dest);
   if(force || res.feasible) {
-    IncrementTravelTime(car, res.extraTravelTime);
+    Record(true, car, car_start[car + 1], dest);
+    IncrementTravelTime(car, res.extraDist);
 
-    car_hops[car].push_back(dest);
+    hops.insert(hops.begin() + car_start[car + 1], dest);
+    ShiftCars(car, 1);
     IncrementVisited(dest, 1);
   }
   return res;
@@ -171,14 +529,16 @@ const TOP_Output::SimulateMoveCarResult TOP_Output::MoveCar(idx_t car, idx_t des
  * @return the index of the point removed
  */ 
 idx_t TOP_Output::RollbackCar(idx_t car) {
-  if(car_hops.empty()) {
+  if(car_start[car + 1] == car_start[car]) {
     throw new runtime_error("Cannot rollback a car that has not moved"); // Debugging and hardening the code
   }
 
   idx_t last = CarPoint(car); // Update all the data about both the point and the car
+  Record(false, car, car_start[car + 1] - 1, last);
   IncrementVisited(last, -1);
-  car_hops[car].pop_back();
-  IncrementTravelTime(car, -SimulateMoveCar(car, last).extraTravelTime);
+  hops.erase(hops.begin() + car_start[car + 1] - 1);
+  ShiftCars(car, -1);
+  IncrementTravelTime(car, -SimulateMoveCar(car, last).extraDist);
 
   return last;
 }
@@ -193,13 +553,10 @@ idx_t TOP_Output::RollbackCar(idx_t car) {
  * @return the struct with the simulation result
  */ 
 const TOP_Output::SimulateMoveCarResult TOP_Output::SimulateMoveCar(idx_t car, idx_t dest) const {
-  const TOP_Point pPart = in.Point(CarPoint(car));
-  const TOP_Point pEnd = in.Point(in.EndPoint());
-  const TOP_Point pDest = in.Point(dest);
-  
   TOP_Output::SimulateMoveCarResult res;
-  res.extraTravelTime = pPart.Distance(pDest) + pDest.Distance(pEnd) - pPart.Distance(pEnd); // Evaluate the additional distance 
-  res.feasible = res.extraTravelTime + TravelTime(car) <= in.MaxTime(); // And the consequent feasibility
+  res.extraDist = in.ExtraDist(CarPoint(car), dest, in.EndPoint()); // Evaluate the additional distance 
+  res.extraTravelTime = FromDist(res.extraDist);
+  res.feasible = res.extraDist + travel_time[car] <= in.MaxDist(); // And the consequent feasibility
   return res;
 }
 
@@ -216,13 +573,16 @@ const TOP_Output::SimulateMoveCarResult TOP_Output::SimulateMoveCar(idx_t car, i
  */ 
 const TOP_Output::SimulateMoveCarResult TOP_Output::InsertHop(idx_t car, idx_t hop, idx_t dest, TOP_Output::InsertMode mode) {
   TOP_Output::SimulateMoveCarResult res;
-  res.extraTravelTime = extraDistance(in.Point(Hop(car, hop - 1)), in.Point(dest), in.Point(Hop(car, hop)));
-  res.feasible = TravelTime(car) + res.extraTravelTime <= in.MaxTime();
+  res.extraDist = in.ExtraDist(Hop(car, hop - 1), dest, Hop(car, hop));
+  res.extraTravelTime = FromDist(res.extraDist);
+  res.feasible = travel_time[car] + res.extraDist <= in.MaxDist();
 
   if(mode != SIMULATE && (mode == FORCE || res.feasible)) { // Update the data of both the car and the point
-    IncrementTravelTime(car, res.extraTravelTime);
+    Record(true, car, car_start[car] + hop - 1, dest);
+    IncrementTravelTime(car, res.extraDist);
 
-    car_hops[car].emplace(car_hops[car].begin() + hop - 1, dest);
+    hops.insert(hops.begin() + car_start[car] + hop - 1, dest);
+    ShiftCars(car, 1);
     IncrementVisited(dest, 1);
   }
   return res;
@@ -237,17 +597,111 @@ const TOP_Output::SimulateMoveCarResult TOP_Output::InsertHop(idx_t car, idx_t h
  */
 const TOP_Output::SimulateMoveCarResult TOP_Output::RemoveHop(idx_t car, idx_t hop) {
   idx_t last = Hop(car, hop);
-  car_hops[car].erase(car_hops[car].begin() + hop - 1); // Remove the point
+  Record(false, car, car_start[car] + hop - 1, last);
+  hops.erase(hops.begin() + car_start[car] + hop - 1); // Remove the point
+  ShiftCars(car, -1);
 
   IncrementVisited(last, -1); // Update the data of both the car and the point
-  double extraDist = extraDistance(in.Point(Hop(car, hop - 1)), in.Point(last), in.Point(Hop(car, hop)));
+  dist_t extraDist = in.ExtraDist(Hop(car, hop - 1), last, Hop(car, hop));
   IncrementTravelTime(car, -extraDist);
 
-  return (TOP_Output::SimulateMoveCarResult){ .feasible = TravelTime(car) <= in.MaxTime(), .extraTravelTime = extraDist };
+  return (TOP_Output::SimulateMoveCarResult){ .feasible = travel_time[car] <= in.MaxDist(), .extraTravelTime = FromDist(extraDist), .extraDist = extraDist };
+}
+
+/**
+ * Rebuild the reachability masks of the cars changed since their last update, with the same
+ * comparison of SimulateMoveCar (extra + TravelDist(car) <= MaxDist)
+ *
+ * @return [void]
+ */
+void TOP_Output::UpdateReachable() {
+  for(idx_t car = 0; car < in.Cars(); ++car) {
+    if(!ReachableUpdated(car)) {
+      in.DetourMaskDist(CarPoint(car), in.EndPoint(), travel_time[car], in.MaxDist(), &reachable[car * MaskWords(in.Points())]);
+      reachable_version[car] = car_version[car];
+    }
+  }
+}
+
+/**
+ * Revert all the changes recorded after the mark that returned token, the
+ * values saved in the trail are restored exactly. The mark stays open so
+ * UndoTo can be called again with the same token
+ *
+ * @param token value returned by Mark()
+ * @return [void]
+ */
+void TOP_Output::UndoTo(trail_t token) {
+  while(trail.size() > token) {
+    const TrailEntry& entry = trail.back();
+    if(entry.inserted) {
+      hops.erase(hops.begin() + entry.pos);
+      ShiftCars(entry.car, -1);
+      UpdateUnvisited(entry.point, visited[entry.point] > 0, visited[entry.point] > 1);
+      --visited[entry.point];
+    } else {
+      hops.insert(hops.begin() + entry.pos, entry.point);
+      ShiftCars(entry.car, 1);
+      UpdateUnvisited(entry.point, visited[entry.point] > 0, true);
+      ++visited[entry.point];
+    }
+    travel_time[entry.car] = entry.travel_time;
+    car_version[entry.car] = entry.car_version;
+    point_profit = entry.point_profit;
+    time_violations = entry.time_violations;
+    trail.pop_back();
+  }
+}
+
+void TOP_Output::TrailMoves(trail_t token, std::vector<TrailMove>& moves) const {
+  for(trail_t i = token; i < trail.size(); ++i) {
+    moves.push_back({ trail[i].inserted, trail[i].car, trail[i].pos, trail[i].point });
+  }
+}
+
+void TOP_Output::ApplyMoves(const TrailMove* moves, std::size_t count) {
+  for(std::size_t i = 0; i < count; ++i) { // InsertHop and RemoveHop at the end of a route compute as MoveCar and RollbackCar
+    idx_t hop = moves[i].pos - car_start[moves[i].car] + 1;
+    if(moves[i].inserted) {
+      InsertHop(moves[i].car, hop, moves[i].point, FORCE);
+    } else {
+      RemoveHop(moves[i].car, hop);
+    }
+  }
+}
+
+/**
+ * Close the last mark opened, when no mark is open the trail is dropped
+ * and the moves are not recorded anymore
+ *
+ * @return [void]
+ */
+void TOP_Output::Release() {
+  if(trail_marks <= 0) {
+    throw logic_error("Cannot release a trail without marks");
+  }
+  if(--trail_marks == 0) {
+    trail.clear();
+  }
 }
 
 // Internals
 
+/**
+ * Save in the undo trail a change that is about to be done (only if a mark is open)
+ *
+ * @param inserted true if the hop is going to be inserted, false if removed
+ * @param car car whose route changes
+ * @param pos position of the hop in the flat routes
+ * @param point point of the hop
+ * @return [void]
+ */
+void TOP_Output::Record(bool inserted, idx_t car, idx_t pos, idx_t point) {
+  if(trail_marks > 0) {
+    trail.push_back({ inserted, car, pos, point, travel_time[car], point_profit, time_violations, car_version[car] });
+  }
+}
+
 /**
  * Calculate the distance between three points to evaluate the extra distance 
  * derivated an insertion or a move 
@@ -257,7 +711,7 @@ const TOP_Output::SimulateMoveCarResult TOP_Output::RemoveHop(idx_t car, idx_t h
  * @param pEnd third and end point
  * @return the sum of the distance between them
  */
-double extraDistance(TOP_Point pStart, TOP_Point pNew, TOP_Point pEnd) {
+double extraDistance(const TOP_Point& pStart, const TOP_Point& pNew, const TOP_Point& pEnd) {
   return pStart.Distance(pNew) + pNew.Distance(pEnd) - pStart.Distance(pEnd);
 }
 
@@ -269,10 +723,11 @@ double extraDistance(TOP_Point pStart, TOP_Point pNew, TOP_Point pEnd) {
  * @param extraTravel the time travel to sum to the current car's travel time
  * @return [void]
  */
-void TOP_Output::IncrementTravelTime(idx_t car, double extraTravel) {
-  bool pre_violation = travel_time[car] > in.MaxTime(); // verify post and pre violation
+void TOP_Output::IncrementTravelTime(idx_t car, dist_t extraTravel) {
+  car_version[car] = ++last_version; // Every move changes the travel time
+  bool pre_violation = travel_time[car] > in.MaxDist(); // verify post and pre violation
   travel_time[car] += extraTravel;
-  bool post_violation = travel_time[car] > in.MaxTime();
+  bool post_violation = travel_time[car] > in.MaxDist();
 
   if(pre_violation && !post_violation) { // Update violations
     --time_violations;
@@ -282,6 +737,20 @@ void TOP_Output::IncrementTravelTime(idx_t car, double extraTravel) {
   }
 }
 
+/**
+ * Update the route offsets after count hops have been added to (or removed from) car:
+ * the routes of the following cars are shifted in the flat vector
+ *
+ * @param car car whose route changed
+ * @param count the number of hops added (negative if removed)
+ * @return [void]
+ */
+void TOP_Output::ShiftCars(idx_t car, int count) {
+  for(idx_t c = car + 1; c < car_start.size(); ++c) {
+    car_start[c] += count;
+  }
+}
+
 /**
  * Update the data of the both the increment/decrement of count of visits of one point
  * and the total profit derivated from one insertion (or remove) or one move (or rollback) 
@@ -301,6 +770,46 @@ void TOP_Output::IncrementVisited(idx_t point, int count) {
   if(!pre_visited && post_visited) {
     point_profit += in.Point(point).Profit();
   }
+  UpdateUnvisited(point, pre_visited, post_visited);
+}
+
+/**
+ * Update the unvisited profit, count and mask when a point changes its visited state
+ *
+ * @param point point to update
+ * @param pre_visited if the point was visited before the change
+ * @param post_visited if the point is visited after the change
+ * @return [void]
+ */
+void TOP_Output::UpdateUnvisited(idx_t point, bool pre_visited, bool post_visited) {
+  if(pre_visited && !post_visited) {
+    unvisited_mask[point / 64] |= uint64_t(1) << (point % 64);
+    unvisited_profit += in.Point(point).Profit();
+    ++unvisited_count;
+    unvisited_hash ^= MixBits(point + 1);
+  }
+  if(!pre_visited && post_visited) {
+    unvisited_mask[point / 64] &= ~(uint64_t(1) << (point % 64));
+    unvisited_profit -= in.Point(point).Profit();
+    --unvisited_count;
+    unvisited_hash ^= MixBits(point + 1);
+  }
+}
+
+/**
+ * Hash of the state, the keys of the tails depend on the car, its last point and its quantized travel time
+ *
+ * @param quantum width of the travel time intervals (0 to leave the travel times out)
+ * @return the hash of the state
+ */
+uint64_t TOP_Output::StateHash(dist_t quantum) const {
+  uint64_t hash = unvisited_hash;
+  for(idx_t car = 0; car < in.Cars(); ++car) {
+    uint64_t slot = quantum > 0 ? (uint64_t)(travel_time[car] / quantum) : 0;
+    uint64_t tail = (uint64_t)(car + 1) << 32 | (uint32_t)CarPoint(car);
+    hash ^= MixBits(MixBits(tail) + slot);
+  }
+  return hash;
 }
 
 /*
@@ -350,15 +859,10 @@ int TOP_Output::PointProfit() const {
  * @return ostream variable
  */
 ostream& operator<<(ostream& os, const TOP_Output& out) {
-  int hops = 0;
-  for(idx_t car = 0; car < out.in.Cars(); ++car) {
-    hops += out.car_hops[car].size();
-  }
-
-  os << "h " << hops << endl;
+  os << "h " << out.hops.size() << endl;
   for(idx_t car = 0; car < out.in.Cars(); ++car) {
-    for(auto hop : out.car_hops[car]) {
-      os << car << "\t" << hop << endl;
+    for(idx_t i = out.car_start[car]; i < out.car_start[car + 1]; ++i) {
+      os << car << "\t" << out.hops[i] << endl;
     }
   }
 
@@ -2,6 +2,7 @@
 #define TOP_DATA_HPP
 
 #include "Utils.hpp"
+#include "TOP_Grid.hpp"
 
 #include <iostream>
 #include <vector>
@@ -9,6 +10,53 @@
 
 // Functions inside class are inlined
 
+// Instances with more points than this compute the distances on the fly instead of
+// keeping the n*n table (4096 points are 128MB of doubles)
+#ifndef DISTANCE_TABLE_MAX_POINTS
+#define DISTANCE_TABLE_MAX_POINTS 4096
+#endif
+
+// Instances with at least this number of points answer the detour queries with the
+// spatial grid, smaller ones are faster with a full (vectorized) scan
+#ifndef GRID_MIN_POINTS
+#define GRID_MIN_POINTS 256
+#endif
+
+// Length of the lists of nearest neighbors computed when an instance is loaded (0 to skip them),
+// used by the granular neighborhoods of the solvers
+#ifndef TOP_NEIGHBORS_K
+#define TOP_NEIGHBORS_K 16
+#endif
+
+// Fixed point mode: define TOP_FIXED_POINT as the scale (i.e. -DTOP_FIXED_POINT=10000) to store the
+// distances and the travel times as int32 multiples of 1 / TOP_FIXED_POINT. The distances are rounded
+// up and the maximum time down, so a route feasible in fixed point is feasible also with the real
+// distances, and the travel times are exact sums (no drift). The table takes half of the memory.
+// Without it the storage type is double and nothing changes.
+#ifdef TOP_FIXED_POINT
+typedef int32_t dist_t;
+#else
+typedef double dist_t;
+#endif
+
+// Conversion of a distance to the storage type (rounded up in fixed point)
+inline dist_t ToDist(double d) {
+#ifdef TOP_FIXED_POINT
+  return (dist_t)std::ceil(d * TOP_FIXED_POINT);
+#else
+  return d;
+#endif
+}
+
+// Conversion of a distance in the storage type to double
+inline double FromDist(dist_t d) {
+#ifdef TOP_FIXED_POINT
+  return (double)d / TOP_FIXED_POINT;
+#else
+  return d;
+#endif
+}
+
 /**
  * Input format:
  *  n {Points}
@@ -47,8 +95,8 @@ class TOP_Point {
     void Divide(int n) { this->x /= n; this->y /= n; this->p /= n; }
 
     // Distance functions
-    double DistanceSq(TOP_Point p2) const { return (this->x - p2.x)*(this->x - p2.x) + (this->y - p2.y)*(this->y - p2.y); }
-    double Distance(TOP_Point p2) const { return sqrt(DistanceSq(p2)); }
+    double DistanceSq(const TOP_Point& p2) const { return (this->x - p2.x)*(this->x - p2.x) + (this->y - p2.y)*(this->y - p2.y); }
+    double Distance(const TOP_Point& p2) const { return sqrt(DistanceSq(p2)); }
     
   private:
     double x, y;
@@ -63,6 +111,8 @@ class TOP_Point {
 class TOP_Input {
     friend std::ostream& operator<<(std::ostream& os, const TOP_Input& in);
     friend std::istream& operator>>(std::istream& is, TOP_Input& in);
+    friend void WriteBinary(const std::string& path, const TOP_Input& in, bool withDistances); // TOP_Binary.hpp
+    friend bool ReadBinary(const std::string& path, TOP_Input& in);
   
   public:
     std::string name;
@@ -90,12 +140,142 @@ class TOP_Input {
     // End point (conventionally the last from instances file)
     idx_t EndPoint() const { return points.size() - 1; } 
 
-    const double Distance(idx_t p1, idx_t p2) const { return Point(p1).Distance(Point(p2)); }
+    // Max travel time admitted in the storage type of the distances (rounded down in fixed point)
+    dist_t MaxDist() const { return max_dist; }
+
+    // Distance between two points in the storage type, read from the table when available
+    dist_t Dist(idx_t p1, idx_t p2) const { 
+      return distances.empty() ? ToDist(Point(p1).Distance(Point(p2))) : distances[p1 * distances_stride + p2];
+    }
+
+    // Extra distance needed to pass through pNew when going from pStart to pEnd in the storage type
+    dist_t ExtraDist(idx_t pStart, idx_t pNew, idx_t pEnd) const {
+      return Dist(pStart, pNew) + Dist(pNew, pEnd) - Dist(pStart, pEnd);
+    }
+
+    // Distance between two points
+    double Distance(idx_t p1, idx_t p2) const { return FromDist(Dist(p1, p2)); }
+
+    // Extra distance needed to pass through pNew when going from pStart to pEnd
+    double ExtraDistance(idx_t pStart, idx_t pNew, idx_t pEnd) const { return FromDist(ExtraDist(pStart, pNew, pEnd)); }
+
+    // Return if the distances are precomputed
+    bool HasDistanceTable() const { return !distances.empty(); }
+
+    // Row of the distance table of p (DistRow(p)[q] == Dist(p, q)), nullptr without the table
+    const dist_t* DistRow(idx_t p) const { return distances.empty() ? nullptr : &distances[p * distances_stride]; }
+
+    // Structure of arrays copy of the points (aligned, padded with zeros to a cache line)
+    const double* Xs() const { return xs.data(); }
+    const double* Ys() const { return ys.data(); }
+    const int* Profits() const { return profits.data(); }
+
+    // Batch kernels (vectorized when compiled with AVX2 or SSE2)
+
+    /**
+     * Distance from p to all the points
+     *
+     * @param p the point considered
+     * @param dist output array of at least Points() elements, dist[q] = Distance(p, q)
+     */
+    void DistancesFrom(idx_t p, double* dist) const;
+
+    /**
+     * Extra distance of the detour through every point when going from pStart to pEnd
+     *
+     * @param pStart starting point of the path
+     * @param pEnd ending point of the path
+     * @param extra output array of at least Points() elements, extra[q] = ExtraDistance(pStart, q, pEnd)
+     */
+    void ExtraDistances(idx_t pStart, idx_t pEnd, double* extra) const;
+
+    /**
+     * Mark the points whose detour from pStart to pEnd fits the budget, bit q is set
+     * when base + ExtraDistance(pStart, q, pEnd) <= limit (same comparison as SimulateMoveCar)
+     *
+     * @param pStart starting point of the path
+     * @param pEnd ending point of the path
+     * @param base value added to the detour (i.e. the current travel time, or 0)
+     * @param limit maximum value admitted
+     * @param mask output of MaskWords(Points()) words, bits after Points() are cleared
+     */
+    void DetourMask(idx_t pStart, idx_t pEnd, double base, double limit, uint64_t* mask) const;
+
+    /**
+     * Same of DetourMask but in the storage type of the distances, bit q is set when
+     * base + ExtraDist(pStart, q, pEnd) <= limit (the exact check of the moves in fixed point)
+     *
+     * @param pStart starting point of the path
+     * @param pEnd ending point of the path
+     * @param base value added to the detour (i.e. the current travel time)
+     * @param limit maximum value admitted
+     * @param mask output of MaskWords(Points()) words, bits after Points() are cleared
+     */
+    void DetourMaskDist(idx_t pStart, idx_t pEnd, dist_t base, dist_t limit, uint64_t* mask) const;
+
+    /**
+     * Call f(q) for every point q not skipped such that base + ExtraDist(pStart, q, pEnd) <= limit,
+     * the points are not in index order. Uses the spatial grid when available (not in fixed point).
+     *
+     * @param pStart starting point of the path
+     * @param pEnd ending point of the path
+     * @param base value added to the detour (i.e. TravelDist of the car, or 0)
+     * @param limit maximum value admitted (i.e. MaxDist)
+     * @param scratch mask of MaskWords(Points()) words owned by the caller, overwritten when the grid is not used
+     * @param skip Function-like entity that returns true for the points to ignore (i.e. visited)
+     * @param f Function-like entity called with the index of each point
+     */
+    template<class _Skip, class _Fn>
+    void ForEachInDetour(idx_t pStart, idx_t pEnd, dist_t base, dist_t limit, uint64_t* scratch, _Skip skip, _Fn f) const;
+
+    // Spatial index of the points (empty for small instances)
+    const TOP_Grid& Grid() const { return grid; }
+
+    /**
+     * Compute the lists of the k nearest points of every point (the point itself excluded), sorted by
+     * distance with the ties broken by index. Called with TOP_NEIGHBORS_K when the instance is loaded,
+     * uses the spatial grid when available.
+     *
+     * @param k length of the lists (limited to Points() - 1, 0 removes them)
+     * @return [void]
+     */
+    void ComputeNeighbors(idx_t k);
+
+    // Length of the lists of nearest neighbors (0 if not computed)
+    idx_t NeighborsK() const { return neighbors_k; }
+
+    // The NeighborsK() points nearest to p sorted by distance, the first k are the k nearest
+    const idx_t* Neighbors(idx_t p) const { return &neighbors[p * neighbors_k]; }
+
+    // Return if q is one of the k points nearest to p (k <= NeighborsK())
+    bool IsNeighbor(idx_t p, idx_t q, idx_t k) const {
+      const idx_t* near = Neighbors(p);
+      return std::find(near, near + k, q) != near + k;
+    }
 
   private:
     int cars;
     double max_time;
+    dist_t max_dist;
     std::vector<TOP_Point> points;
+
+    // Structure of arrays mirror of points used by the batch kernels
+    std::vector<double, AlignedAllocator<double>> xs, ys;
+    std::vector<int, AlignedAllocator<int>> profits;
+
+    // Symmetric distance table, each row is padded to a cache line
+    std::vector<dist_t, AlignedAllocator<dist_t>> distances; // distances[p1 * distances_stride + p2]
+    idx_t distances_stride;
+
+    TOP_Grid grid;
+
+    // Nearest neighbors of each point, neighbors[p * neighbors_k + i] is the (i + 1)-th nearest to p
+    std::vector<idx_t> neighbors;
+    idx_t neighbors_k;
+
+    void ComputeArrays();
+    void ComputeDistances();
+    void ComputeMaxDist();
 };
 
 /**
@@ -113,6 +293,7 @@ class TOP_Output {
     struct SimulateMoveCarResult { // Move simulation
       bool feasible;
       double extraTravelTime;
+      dist_t extraDist; // Same in the storage type of the distances
     };
     enum InsertMode { // Insertion move
       SIMULATE,
@@ -122,32 +303,38 @@ class TOP_Output {
 
     // Input constructor
     TOP_Output(const TOP_Input& in) : in(in),
-      car_hops(in.Cars()), visited(in.Points()),
-      travel_time(in.Cars()) { Clear(); }
+      car_start(in.Cars() + 1), visited(in.Points()), unvisited_mask(MaskWords(in.Points())),
+      travel_time(in.Cars()), car_version(in.Cars()), last_version(0),
+      reachable(in.Cars() * MaskWords(in.Points())), reachable_version(in.Cars(), 0) { hops.reserve(in.Points()); Clear(); }
     void Clear();
 
-    // Output constructor
+    // Output constructors, the routes are flat vectors so a copy is a handful of memcpy
+    // (the undo trail is not copied, only moved)
     TOP_Output(const TOP_Output& out) : in(out.in),
-      car_hops(out.car_hops), visited(out.visited),
+      hops(out.hops), car_start(out.car_start), visited(out.visited),
+      unvisited_mask(out.unvisited_mask),
+      unvisited_profit(out.unvisited_profit),
+      unvisited_count(out.unvisited_count),
+      unvisited_hash(out.unvisited_hash),
       travel_time(out.travel_time),
       point_profit(out.point_profit),
-      time_violations(out.time_violations) {}
-
-    // operator= overwrite two outputs
-    TOP_Output& operator=(const TOP_Output& out) { 
-      const_cast<TOP_Input&>(this->in) = out.in;
-      this->car_hops = out.car_hops;
-      this->visited = out.visited;
-      this->travel_time = out.travel_time;
-      this->point_profit = out.point_profit;
-      this->time_violations = out.time_violations;
-      return *this;
-    }
+      time_violations(out.time_violations),
+      car_version(out.car_version), last_version(out.last_version),
+      reachable(out.reachable), reachable_version(out.reachable_version),
+      trail_marks(0) {}
+    TOP_Output(TOP_Output&& out) = default;
+
+    // operator= overwrite two outputs of the same input (reusing the allocated memory)
+    TOP_Output& operator=(const TOP_Output& out);
+    TOP_Output& operator=(TOP_Output&& out);
 
     // Basic functions
 
     // return the travel time of one specified car
-    double TravelTime(idx_t car) const { return travel_time[car]; }
+    double TravelTime(idx_t car) const { return FromDist(travel_time[car]); }
+
+    // return the travel time of one specified car in the storage type of the distances
+    dist_t TravelDist(idx_t car) const { return travel_time[car]; }
 
     // Verify if one point is already visited 
     bool Visited(idx_t point) const { return visited[point] > 0; }
@@ -161,46 +348,166 @@ class TOP_Output {
      // Return the profit already gained
     int PointProfit() const { return point_profit; }
 
+    // Return the profit sum and the number of the points not visited yet
+    int UnvisitedProfit() const { return unvisited_profit; }
+    idx_t UnvisitedCount() const { return unvisited_count; }
+
+    // Return the bit mask of the points not visited yet (MaskWords(in.Points()) words)
+    const uint64_t* UnvisitedMask() const { return unvisited_mask.data(); }
+
+    /**
+     * Zobrist hash of the state: the set of visited points (kept by the moves), the last point of each car
+     * and its travel time divided by quantum (combined on request). Two outputs with the same visited points
+     * and the same tails have the same hash if the travel times of their cars fall in the same quanta.
+     *
+     * @param quantum width of the travel time intervals (0 to leave the travel times out)
+     * @return the hash of the state
+     */
+    uint64_t StateHash(dist_t quantum) const;
+
     // Return the hops made by one car
-    int Hops(idx_t car) const { return car_hops[car].size() + 1; } 
+    int Hops(idx_t car) const { return car_start[car + 1] - car_start[car] + 1; } 
     
     // Return the last point inserted from a specified car
     idx_t CarPoint(idx_t car) const { 
-      return car_hops[car].empty() ? in.StartPoint() : car_hops[car].back(); 
+      return car_start[car + 1] == car_start[car] ? in.StartPoint() : hops[car_start[car + 1] - 1]; 
     } 
 
     // Return the point index reached by the car in its one specific hop
     idx_t Hop(idx_t car, idx_t hop) const { 
       if(hop <= 0) return in.StartPoint();
-      if(hop > car_hops[car].size()) return in.EndPoint();
-      return car_hops[car][hop - 1];
+      if(hop >= Hops(car)) return in.EndPoint();
+      return hops[car_start[car] + hop - 1];
     }
     
+    // Reachable points: bit p of the mask of car is set iff SimulateMoveCar(car, p).feasible.
+    // The masks are rebuilt by UpdateReachable only for the cars changed since the last update,
+    // the ones reverted by UndoTo are valid again without being rebuilt
+    void UpdateReachable();
+
+    // Version of the car, changed by every move of the car and restored by UndoTo (a cache key for its state)
+    uint64_t CarVersion(idx_t car) const { return car_version[car]; }
+
+    // Return if the mask of the car describes the current state
+    bool ReachableUpdated(idx_t car) const { return reachable_version[car] == car_version[car]; }
+
+    // Return the mask of the points reachable by the car (MaskWords(in.Points()) words), valid only if ReachableUpdated(car)
+    const uint64_t* ReachableMask(idx_t car) const { return &reachable[car * MaskWords(in.Points())]; }
+
+    // Verify if the point can be reached by the car (from the mask when updated)
+    bool Reachable(idx_t car, idx_t point) const {
+      if(ReachableUpdated(car)) {
+        return (ReachableMask(car)[point / 64] >> (point % 64)) & 1;
+      }
+      return SimulateMoveCar(car, point).feasible;
+    }
+
+    // Verify if the point can be reached by at least one car
+    bool ReachableByAny(idx_t point) const {
+      for(idx_t car = 0; car < in.Cars(); ++car) {
+        if(Reachable(car, point)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
     // Move functions
     idx_t RollbackCar(idx_t car); 
     const SimulateMoveCarResult MoveCar(idx_t car, idx_t dest, bool force = true); 
     const SimulateMoveCarResult SimulateMoveCar(idx_t car, idx_t dest) const;
     const SimulateMoveCarResult InsertHop(idx_t car, idx_t hop, idx_t dest, InsertMode mode = FORCE);
     const SimulateMoveCarResult RemoveHop(idx_t car, idx_t hop);
+
+    // Undo trail: while at least one mark is open every move is recorded and
+    // UndoTo(token) reverts all the changes done after the Mark() that returned token
+    typedef std::size_t trail_t;
+    trail_t Mark() { ++trail_marks; return trail.size(); }
+    void UndoTo(trail_t token);
+    void Release();
+
+    // A change recorded in the trail, enough to repeat it on an output in the same state
+    struct TrailMove {
+      bool inserted; // The hop has been inserted (otherwise it has been removed)
+      idx_t car;
+      idx_t pos; // Position of the hop in the routes
+      idx_t point;
+    };
+
+    // Append to moves the changes done after the Mark() that returned token (oldest first)
+    void TrailMoves(trail_t token, std::vector<TrailMove>& moves) const;
+
+    // Repeat the changes of TrailMoves on an output in the state of the mark, the result
+    // is the same (travel times included) of the original moves
+    void ApplyMoves(const TrailMove* moves, std::size_t count);
     
     const TOP_Input& in;
 
   private:
 
-    std::vector<std::vector<idx_t>> car_hops; // car_hops[car][hop] = point
+    std::vector<idx_t> hops; // Routes of all the cars back to back
+    std::vector<idx_t> car_start; // Route of car is hops[car_start[car]:car_start[car + 1]]
     std::vector<int> visited; // Number of visits for each point
     
     // Redundant data
-    std::vector<double> travel_time;
+    std::vector<uint64_t> unvisited_mask; // Bit set if visited[point] == 0
+    int unvisited_profit;
+    idx_t unvisited_count;
+    uint64_t unvisited_hash; // Xor of the keys of the points not visited yet
+    std::vector<dist_t> travel_time;
     int point_profit;
     int time_violations;
+
+    // Reachability masks, each change of a car gives it a new version
+    std::vector<uint64_t> car_version;
+    uint64_t last_version;
+    std::vector<uint64_t> reachable; // Masks of all the cars back to back
+    std::vector<uint64_t> reachable_version; // Version of each car when its mask was built
+
+    // Undo trail
+    struct TrailEntry {
+      bool inserted; // The hop has been inserted (otherwise it has been removed)
+      idx_t car;
+      idx_t pos; // Position of the hop in hops
+      idx_t point;
+      dist_t travel_time; // Values before the change
+      int point_profit;
+      int time_violations;
+      uint64_t car_version;
+    };
+    std::vector<TrailEntry> trail;
+    int trail_marks;
     
     // Internal functions
     void IncrementVisited(idx_t point, int count);
-    void IncrementTravelTime(idx_t car, double count);
+    void UpdateUnvisited(idx_t point, bool pre_visited, bool post_visited);
+    void IncrementTravelTime(idx_t car, dist_t count);
+    void ShiftCars(idx_t car, int count);
+    void Record(bool inserted, idx_t car, idx_t pos, idx_t point);
 };
 
+/******************
+ * Implementation *
+ ******************/
+
+template<class _Skip, class _Fn>
+void TOP_Input::ForEachInDetour(idx_t pStart, idx_t pEnd, dist_t base, dist_t limit, uint64_t* scratch, _Skip skip, _Fn f) const {
+#ifndef TOP_FIXED_POINT // The grid works on the coordinates
+  double direct = Distance(pStart, pEnd);
+  if(grid.Selective(direct, base, limit)) {
+    grid.EllipseQuery(xs[pStart], ys[pStart], xs[pEnd], ys[pEnd], direct, base, limit, skip, f);
+    return;
+  }
+#endif
+  DetourMaskDist(pStart, pEnd, base, limit, scratch);
+  ForEachMaskBit(scratch, MaskWords(Points()), [&skip, &f](idx_t q) {
+    if(!skip(q)) {
+      f(q);
+    }
+  });
+}
+
 // Internals
-double extraDistance(TOP_Point pStart, TOP_Point pNew, TOP_Point pEnd);
+double extraDistance(const TOP_Point& pStart, const TOP_Point& pNew, const TOP_Point& pEnd);
 
 #endif
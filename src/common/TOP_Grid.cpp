@@ -0,0 +1,107 @@
+#include "TOP_Grid.hpp"
+
+using namespace std;
+
+/**
+ * Clear the grid
+ *
+ * @return [void]
+ */
+void TOP_Grid::Clear() {
+  cols = rows = 0;
+  minX = minY = 0;
+  cellSize = 1;
+  cellStart.clear();
+  cellIdxs.clear();
+  cellXs.clear();
+  cellYs.clear();
+}
+
+void TOP_Grid::Build(const double* xs, const double* ys, idx_t n) {
+  Clear();
+  if(n <= 0) {
+    return;
+  }
+
+  double maxX = xs[0], maxY = ys[0];
+  minX = xs[0];
+  minY = ys[0];
+  for(idx_t i = 1; i < n; ++i) { // Bounding box of the instance
+    minX = min(minX, xs[i]);
+    maxX = max(maxX, xs[i]);
+    minY = min(minY, ys[i]);
+    maxY = max(maxY, ys[i]);
+  }
+
+  // Square cells sized to hold GRID_POINTS_PER_CELL points on average
+  double width = max(maxX - minX, 1e-9), height = max(maxY - minY, 1e-9);
+  double cells = max(1.0, (double)n / GRID_POINTS_PER_CELL);
+  cellSize = max(sqrt(width * height / cells), max(width, height) / cells);
+  cols = (idx_t)floor(width / cellSize) + 1;
+  rows = (idx_t)floor(height / cellSize) + 1;
+
+  // Counting sort of the points by cell
+  vector<idx_t> pointCell(n);
+  cellStart.assign(cols * rows + 1, 0);
+  for(idx_t i = 0; i < n; ++i) {
+    pointCell[i] = Row(ys[i]) * cols + Col(xs[i]);
+    ++cellStart[pointCell[i] + 1];
+  }
+  for(idx_t c = 0; c < cols * rows; ++c) {
+    cellStart[c + 1] += cellStart[c];
+  }
+
+  vector<idx_t> fill(cellStart.begin(), cellStart.end() - 1);
+  cellIdxs.resize(n);
+  cellXs.resize(n);
+  cellYs.resize(n);
+  for(idx_t i = 0; i < n; ++i) { // Increasing index inside each cell
+    idx_t k = fill[pointCell[i]]++;
+    cellIdxs[k] = i;
+    cellXs[k] = xs[i];
+    cellYs[k] = ys[i];
+  }
+}
+
+void TOP_Grid::Nearest(double x, double y, idx_t k, idx_t skip, vector<pair<double, idx_t>>& found) const {
+  found.clear(); // Max heap of the nearest points found so far
+  if(Empty() || k <= 0) {
+    return;
+  }
+
+  idx_t col0 = Col(x), row0 = Row(y);
+  idx_t maxRing = max({ col0, cols - 1 - col0, row0, rows - 1 - row0 });
+  for(idx_t ring = 0; ring <= maxRing; ++ring) {
+    // The cells of the ring are at least (ring - 1) cells away from (x, y)
+    if((idx_t)found.size() == k && found.front().first < (ring - 1) * cellSize) {
+      break;
+    }
+    for(idx_t row = max(row0 - ring, 0); row <= min(row0 + ring, rows - 1); ++row) {
+      bool edge = row == row0 - ring || row == row0 + ring;
+      idx_t step = edge ? 1 : 2 * ring; // Only the first and the last column inside the ring
+      for(idx_t col = col0 - ring; col <= col0 + ring; col += max<idx_t>(step, 1)) {
+        if(col < 0 || col >= cols) {
+          continue;
+        }
+        idx_t cell = row * cols + col;
+        for(idx_t i = cellStart[cell]; i < cellStart[cell + 1]; ++i) {
+          idx_t q = cellIdxs[i];
+          if(q == skip) {
+            continue;
+          }
+          double dx = x - cellXs[i], dy = y - cellYs[i];
+          pair<double, idx_t> entry { sqrt(dx*dx + dy*dy), q };
+          if((idx_t)found.size() < k) {
+            found.push_back(entry);
+            push_heap(found.begin(), found.end());
+          } else if(entry < found.front()) {
+            pop_heap(found.begin(), found.end());
+            found.back() = entry;
+            push_heap(found.begin(), found.end());
+          }
+        }
+      }
+    }
+  }
+  sort_heap(found.begin(), found.end());
+}
@@ -0,0 +1,162 @@
+#ifndef TOP_GRID_HPP
+#define TOP_GRID_HPP
+
+#include "Utils.hpp"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Average number of points in each cell of the grid
+#ifndef GRID_POINTS_PER_CELL
+#define GRID_POINTS_PER_CELL 2
+#endif
+
+// Ellipses covering more than this fraction of the grid are faster with a full scan
+#ifndef GRID_MAX_COVERAGE
+#define GRID_MAX_COVERAGE 0.2
+#endif
+
+/**
+ * Uniform grid over the points of an instance used to answer the detour (ellipse) queries:
+ * which points q satisfy d(a, q) + d(q, b) - d(a, b) <= budget? Only the cells that intersect
+ * the ellipse with foci a and b are visited, so the cost depends on the ellipse size and not
+ * on the number of points.
+ * The points are stored sorted by cell (CSR layout) with a copy of their coordinates.
+ */
+class TOP_Grid {
+  public:
+    TOP_Grid() { Clear(); }
+    void Clear();
+
+    /**
+     * Build the grid from the coordinates of the points
+     *
+     * @param xs x coordinates
+     * @param ys y coordinates
+     * @param n number of points
+     * @return [void]
+     */
+    void Build(const double* xs, const double* ys, idx_t n);
+
+    // Return if the grid has been built
+    bool Empty() const { return cols == 0; }
+
+    /**
+     * Return if a query is selective enough to be faster than a full scan, that is if the
+     * area of the ellipse is at most GRID_MAX_COVERAGE of the grid
+     *
+     * @param direct distance between the two foci
+     * @param base value added to the detour
+     * @param limit maximum value admitted
+     * @return true if EllipseQuery should be used
+     */
+    bool Selective(double direct, double base, double limit) const {
+      if(Empty()) {
+        return false;
+      }
+      double semiMajor = (limit - base + direct) / 2; // The area of the ellipse is pi * a * b
+      double semiMinor = std::sqrt(std::max(0.0, semiMajor * semiMajor - direct * direct / 4));
+      return M_PI * semiMajor * semiMinor <= GRID_MAX_COVERAGE * cols * rows * cellSize * cellSize;
+    }
+
+    /**
+     * Call f(q) for every point q (not skipped) with base + d(a, q) + d(q, b) - direct <= limit.
+     * The check is done with the same operations of TOP_Input::DetourMask, the order of the
+     * points is not the index order.
+     *
+     * @param ax x coordinate of the first focus
+     * @param ay y coordinate of the first focus
+     * @param bx x coordinate of the second focus
+     * @param by y coordinate of the second focus
+     * @param direct distance between the two foci
+     * @param base value added to the detour
+     * @param limit maximum value admitted
+     * @param skip Function-like entity that returns true for the points to ignore (i.e. visited)
+     * @param f Function-like entity called with the index of each point inside the ellipse
+     * @return [void]
+     */
+    template<class _Skip, class _Fn>
+    void EllipseQuery(double ax, double ay, double bx, double by, double direct, double base, double limit, _Skip skip, _Fn f) const;
+
+    /**
+     * Find the k points nearest to (x, y), visiting the rings of cells around its cell until the
+     * remaining rings cannot contain nearer points. The ties are broken by the lowest index.
+     *
+     * @param x x coordinate
+     * @param y y coordinate
+     * @param k number of points wanted
+     * @param skip point to ignore (i.e. the one at (x, y)), -1 for none
+     * @param found filled with the (distance, point) pairs sorted by increasing distance
+     * @return [void]
+     */
+    void Nearest(double x, double y, idx_t k, idx_t skip, std::vector<std::pair<double, idx_t>>& found) const;
+
+  private:
+    idx_t cols, rows;
+    double minX, minY, cellSize;
+    std::vector<idx_t> cellStart; // Points of cell c are in [cellStart[c], cellStart[c + 1])
+    std::vector<idx_t> cellIdxs; // Point index sorted by cell
+    std::vector<double> cellXs, cellYs; // Coordinates sorted by cell
+
+    idx_t Col(double x) const { return std::clamp<idx_t>((idx_t)std::floor((x - minX) / cellSize), 0, cols - 1); }
+    idx_t Row(double y) const { return std::clamp<idx_t>((idx_t)std::floor((y - minY) / cellSize), 0, rows - 1); }
+};
+
+/******************
+ * Implementation *
+ ******************/
+
+template<class _Skip, class _Fn>
+void TOP_Grid::EllipseQuery(double ax, double ay, double bx, double by, double direct, double base, double limit, _Skip skip, _Fn f) const {
+  if(Empty()) {
+    return;
+  }
+
+  // Maximum value of d(a, q) + d(q, b), with a small margin for the rounding of the exact check
+  double reach = limit - base + direct;
+  reach += 1e-9 * (1.0 + std::abs(reach) + direct);
+  if(reach < direct) {
+    return;
+  }
+
+  // Bounding box of the ellipse (intersection of the circles of radius reach around the foci)
+  double loX = std::max(ax, bx) - reach, hiX = std::min(ax, bx) + reach;
+  double loY = std::max(ay, by) - reach, hiY = std::min(ay, by) + reach;
+  if(loX > hiX || loY > hiY) {
+    return;
+  }
+
+  for(idx_t row = Row(loY); row <= Row(hiY); ++row) {
+    double y0 = minY + row * cellSize, y1 = y0 + cellSize;
+    double dya = std::max({ y0 - ay, 0.0, ay - y1 });
+    double dyb = std::max({ y0 - by, 0.0, by - y1 });
+
+    for(idx_t col = Col(loX); col <= Col(hiX); ++col) {
+      double x0 = minX + col * cellSize, x1 = x0 + cellSize;
+      double dxa = std::max({ x0 - ax, 0.0, ax - x1 });
+      double dxb = std::max({ x0 - bx, 0.0, bx - x1 });
+
+      // The nearest point of the cell to each focus bounds the detour of the whole cell
+      if(std::sqrt(dxa*dxa + dya*dya) + std::sqrt(dxb*dxb + dyb*dyb) > reach) {
+        continue;
+      }
+
+      idx_t cell = row * cols + col;
+      for(idx_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+        idx_t q = cellIdxs[k];
+        if(skip(q)) {
+          continue;
+        }
+        double qax = ax - cellXs[k], qay = ay - cellYs[k];
+        double qbx = bx - cellXs[k], qby = by - cellYs[k];
+        double d = (std::sqrt(qax*qax + qay*qay) + std::sqrt(qbx*qbx + qby*qby)) - direct;
+        if(d + base <= limit) {
+          f(q);
+        }
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include "TOP_Rating.hpp"
+
+using namespace std;
+
+TOP_Ratings::TOP_Ratings(const TOP_Input& in) : in(in),
+  stride(in.Points()),
+  carVersions(in.Cars()), tails(in.Cars()),
+  rowBuffers(in.HasDistanceTable() ? 0 : in.Cars() * stride), endDist(in.Points()),
+  extra(in.Cars() * stride), nearestDist(in.Points()), timeFactor(in.Cars() * stride), nearest(in.Points()),
+  ratings(in.Points()), detourMask(MaskWords(in.Points())), wProfit(1), wTime(0), wNonCost(0), mode(FIRST_REACHABLE) {
+  for(idx_t q = 0; q < in.Points(); ++q) {
+    endDist[q] = in.Dist(in.EndPoint(), q); // The table is symmetric
+  }
+  Invalidate();
+}
+
+void TOP_Ratings::Invalidate() {
+  fill(carVersions.begin(), carVersions.end(), UINT64_MAX); // Never used by the outputs
+}
+
+void TOP_Ratings::Update(const TOP_Output& out) {
+  idx_t nPoints = in.Points();
+  bool changed = false;
+  for(idx_t car = 0; car < in.Cars(); ++car) {
+    if(out.CarVersion(car) == carVersions[car]) {
+      continue;
+    }
+    carVersions[car] = out.CarVersion(car);
+    changed = true;
+
+    idx_t tail = tails[car] = out.CarPoint(car);
+    if(!rowBuffers.empty()) { // Computed on the fly without the table
+      dist_t* buffer = &rowBuffers[car * stride];
+      for(idx_t q = 0; q < nPoints; ++q) {
+        buffer[q] = in.Dist(tail, q);
+      }
+    }
+    const dist_t* row = Row(car);
+
+    // Same operations of SimulateMoveCar and of the travel time factor, for all the points
+    dist_t direct = in.Dist(tail, in.EndPoint());
+    double gamma = out.TravelTime(car) / in.MaxTime();
+    double remaining = in.MaxTime() - out.TravelTime(car);
+    dist_t* carExtra = &extra[car * stride];
+    double* carFactor = &timeFactor[car * stride];
+    for(idx_t q = 0; q < nPoints; ++q) {
+      carExtra[q] = row[q] + endDist[q] - direct;
+    }
+    if(remaining == 0.0) {
+      fill(carFactor, carFactor + nPoints, gamma * INFINITY);
+    } else {
+      for(idx_t q = 0; q < nPoints; ++q) {
+        carFactor[q] = gamma * (FromDist(carExtra[q]) / remaining);
+      }
+    }
+  }
+
+  if(changed) { // Argmin over the rows (the first car wins the ties)
+    copy(Row(0), Row(0) + nPoints, nearestDist.begin());
+    fill(nearest.begin(), nearest.end(), 0);
+    for(idx_t car = 1; car < in.Cars(); ++car) {
+      const dist_t* row = Row(car);
+      for(idx_t q = 0; q < nPoints; ++q) {
+        bool nearer = row[q] < nearestDist[q];
+        nearestDist[q] = nearer ? row[q] : nearestDist[q];
+        nearest[q] = nearer ? car : nearest[q];
+      }
+    }
+  }
+}
+
+idx_t TOP_Ratings::FirstReachableAfter(const TOP_Output& out, idx_t car, idx_t p, idx_t first) const {
+  dist_t base = out.TravelDist(car) + ExtraDist(car, p); // Travel time of the car after the move
+  const dist_t* row = in.DistRow(p);
+  dist_t direct = in.Dist(p, in.EndPoint());
+  const uint64_t* unvisited = out.UnvisitedMask();
+  for(idx_t w = first / 64; w < MaskWords(in.Points()); ++w) {
+    uint64_t bits = unvisited[w];
+    if(w == first / 64) {
+      bits &= ~uint64_t(0) << (first % 64);
+    }
+    if(w == p / 64) {
+      bits &= ~(uint64_t(1) << (p % 64)); // Visited by the move
+    }
+    for(; bits; bits &= bits - 1) {
+      idx_t point = w * 64 + __builtin_ctzll(bits);
+      dist_t extraDist = (row != nullptr ? row[point] : in.Dist(p, point)) + endDist[point] - direct;
+      if(extraDist + base <= in.MaxDist()) {
+        return point;
+      }
+    }
+  }
+  return -1;
+}
+
+int TOP_Ratings::ReachableProfitAfter(const TOP_Output& out, idx_t car, idx_t p) const {
+  int profit = 0;
+  dist_t base = out.TravelDist(car) + ExtraDist(car, p); // Travel time of the car after the move
+  in.ForEachInDetour(p, in.EndPoint(), base, in.MaxDist(), detourMask.data(),
+    [&out, p](idx_t point) { return point == p || out.Visited(point); },
+    [this, &profit](idx_t point) { profit += in.Point(point).Profit(); }
+  );
+  return profit;
+}
+
+double TOP_Ratings::Combine(const TOP_Output& out, idx_t p, double timeFactor, double lostProfit, double wProfit, double wTime, double wNonCost) {
+  double profit = out.in.Point(p).Profit();
+
+  // Factor dependent on the profit (maintained by the output)
+  double notVisitedCount = out.UnvisitedCount();
+  double sumProfit = out.UnvisitedProfit();
+  double meanProfit;
+  if(notVisitedCount == 0.0) {
+    meanProfit = INFINITY;
+  }
+  else {
+    meanProfit = sumProfit / notVisitedCount;
+  }
+
+  // Factor dependent on the cost (losses) of chosing another point
+  double noChoice;
+  if(sumProfit == 0.0) {
+    noChoice = INFINITY;
+  }
+  else {
+    noChoice = lostProfit / sumProfit;
+  }
+
+  return (profit / meanProfit) * wProfit - timeFactor * wTime + noChoice * wNonCost;
+}
+
+double TOP_Ratings::LostProfit(const TOP_Output& out, idx_t car, idx_t p, LossMode mode) const {
+  if(mode == REACHABLE_PROFIT) {
+    return ReachableProfitAfter(out, car, p);
+  }
+  idx_t found = FirstReachableAfter(out, car, p, 0);
+  return found < 0 ? 0.0 : in.Point(found).Profit();
+}
+
+void TOP_Ratings::RateAll(const TOP_Output& out, double wProfit, double wTime, double wNonCost, LossMode mode, const uint64_t* candidates) {
+  this->wProfit = wProfit;
+  this->wTime = wTime;
+  this->wNonCost = wNonCost;
+  this->mode = mode;
+  for(idx_t p = 0; p < in.Points(); ++p) {
+    if(out.Visited(p) || !out.ReachableByAny(p) || (candidates != nullptr && !(candidates[p / 64] >> (p % 64) & 1))) {
+      ratings[p] = -INFINITY;
+      continue;
+    }
+    idx_t car = nearest[p];
+    ratings[p] = Combine(out, p, TimeFactor(car, p), LostProfit(out, car, p, mode), wProfit, wTime, wNonCost);
+  }
+}
+
+double TOP_Ratings::Rating(const TOP_Output& out, idx_t car, idx_t p) const {
+  if(car == nearest[p]) {
+    return ratings[p];
+  }
+  return Combine(out, p, TimeFactor(car, p), LostProfit(out, car, p, mode), wProfit, wTime, wNonCost);
+}
@@ -0,0 +1,143 @@
+#ifndef TOP_RATING_HPP
+#define TOP_RATING_HPP
+
+#include "TOP_Data.hpp"
+
+#include <vector>
+
+/**
+ * Batch computation of the components of the greedy rating of all the points, shared by the greedy and by the
+ * backtracking. For each car it keeps the distance of every point from the last point of the car, the extra
+ * distance to visit the point before the end and the travel time factor. The rows of a car are recomputed in one
+ * pass only when the car has moved (see TOP_Output::CarVersion), the nearest car of every point is updated with
+ * an argmin over the rows. The buffers are reused by all the updates.
+ * The values are the same (bit by bit) of the ones computed point by point with SimulateMoveCar and MoveCar.
+ *
+ * Typical usage:
+ *   TOP_Ratings ratings(in);
+ *   ratings.Update(out); // After every change of out
+ *   ratings.RateAll(out, wProfit, wTime, wNonCost, TOP_Ratings::REACHABLE_PROFIT);
+ *   ... ratings.Rating(p) ...
+ */
+class TOP_Ratings {
+  public:
+    // Estimate of the profit lost when a point is not chosen (the third component of the rating)
+    enum LossMode {
+      FIRST_REACHABLE, // Profit of the first point (in index order) reachable by the car after the point
+      REACHABLE_PROFIT // Profit of all the points reachable by the car after the point
+    };
+
+    TOP_Ratings(const TOP_Input& in);
+
+    /**
+     * Recompute the rows of the cars changed since the last update and the nearest cars
+     *
+     * @param out current state
+     * @return [void]
+     */
+    void Update(const TOP_Output& out);
+
+    /**
+     * Recompute all the rows at the next update, needed when the output is replaced by one that is not
+     * derived by moves from the last one (the versions of the cars are comparable only along the moves)
+     *
+     * @return [void]
+     */
+    void Invalidate();
+
+    // Car nearest to the last point of the cars (the first one in case of ties)
+    idx_t NearestCar(idx_t p) const { return nearest[p]; }
+
+    // Distance of p from the last point of car
+    dist_t Dist(idx_t car, idx_t p) const { return Row(car)[p]; }
+
+    // Extra distance of car to visit p before the end, same of SimulateMoveCar(car, p).extraDist
+    dist_t ExtraDist(idx_t car, idx_t p) const { return extra[car * stride + p]; }
+
+    // Fraction of the time used by the car multiplied by the fraction of the remaining time needed to visit p
+    double TimeFactor(idx_t car, idx_t p) const { return timeFactor[car * stride + p]; }
+
+    /**
+     * Return the first point not visited (in index order, starting from first) that the car could still reach
+     * after moving to p, the state is not changed
+     *
+     * @param out current state
+     * @param car the car moved to p
+     * @param p the point considered (not visited)
+     * @param first first index to test
+     * @return the point found, -1 if there is none
+     */
+    idx_t FirstReachableAfter(const TOP_Output& out, idx_t car, idx_t p, idx_t first) const;
+
+    /**
+     * Return the profit of the points not visited that the car could still reach after moving to p
+     *
+     * @param out current state
+     * @param car the car moved to p
+     * @param p the point considered (not visited)
+     * @return sum of the profits
+     */
+    int ReachableProfitAfter(const TOP_Output& out, idx_t car, idx_t p) const;
+
+    /**
+     * Combine the components into the rating of a point
+     *
+     * @param out current state
+     * @param p the point considered
+     * @param timeFactor travel time factor of the car considered
+     * @param lostProfit profit lost if the point is not chosen
+     * @param wProfit weight that multiplies the first (profit) factor of the rating equation
+     * @param wTime weight that multiplies the second (travel time) factor of the rating equation
+     * @param wNonCost weight that multiplies the third (cost of no choice) factor of the rating equation
+     * @return rating of the point
+     */
+    static double Combine(const TOP_Output& out, idx_t p, double timeFactor, double lostProfit, double wProfit, double wTime, double wNonCost);
+
+    /**
+     * Compute the rating of every point for its nearest car, the points visited or not reachable by any car
+     * are rated -INFINITY. Update must be called before.
+     *
+     * @param out current state
+     * @param wProfit weight that multiplies the first (profit) factor of the rating equation
+     * @param wTime weight that multiplies the second (travel time) factor of the rating equation
+     * @param wNonCost weight that multiplies the third (cost of no choice) factor of the rating equation
+     * @param mode estimate of the profit lost
+     * @param candidates if not null only the points with the bit set are rated, the others are -INFINITY
+     * @return [void]
+     */
+    void RateAll(const TOP_Output& out, double wProfit, double wTime, double wNonCost, LossMode mode, const uint64_t* candidates = nullptr);
+
+    // Rating of p for its nearest car computed by RateAll
+    double Rating(idx_t p) const { return ratings[p]; }
+
+    /**
+     * Rating of a point (not visited) for any car, with the weights and the mode of the last RateAll
+     *
+     * @param out current state
+     * @param car the car considered
+     * @param p the point considered
+     * @return rating of the point for the car
+     */
+    double Rating(const TOP_Output& out, idx_t car, idx_t p) const;
+
+  private:
+    const TOP_Input& in;
+    idx_t stride; // Row length of the buffers of the cars (Points())
+    std::vector<uint64_t> carVersions; // Version of each car when its rows were computed
+    std::vector<idx_t> tails; // Last point of each car
+    std::vector<dist_t> rowBuffers, endDist; // Rows computed without the table, distances from the end
+    std::vector<dist_t> extra, nearestDist;
+    std::vector<double> timeFactor;
+    std::vector<idx_t> nearest;
+    std::vector<double> ratings;
+    mutable std::vector<uint64_t> detourMask; // Scratch mask of ForEachInDetour (no allocation per rated point)
+    double wProfit, wTime, wNonCost;
+    LossMode mode;
+
+    // Distances from the last point of car (the row of the table when available)
+    const dist_t* Row(idx_t car) const { return rowBuffers.empty() ? in.DistRow(tails[car]) : &rowBuffers[car * stride]; }
+
+    double LostProfit(const TOP_Output& out, idx_t car, idx_t p, LossMode mode) const;
+};
+
+#endif
@@ -10,9 +10,81 @@
 #include <shared_mutex>
 #include <sstream>
 #include <iostream>
+#include <utility>
+#include <new>
+#include <cstddef>
+#include <cstdint>
 
 typedef int idx_t;
 
+#define CACHE_LINE_SIZE 64
+
+/**
+ * STL allocator that returns memory aligned to Align bytes (by default a cache line),
+ * useful for flat tables read in tight loops
+ *
+ * Typical usage:
+ *   std::vector<double, AlignedAllocator<double>> table(n);
+ */
+template<typename T, std::size_t Align = CACHE_LINE_SIZE>
+class AlignedAllocator {
+  public:
+    using value_type = T;
+    template<typename U>
+    struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() noexcept {}
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+      return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+    void deallocate(T* p, std::size_t) noexcept {
+      ::operator delete(p, std::align_val_t(Align));
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Align>&) const noexcept { return true; }
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Align>&) const noexcept { return false; }
+};
+
+/**
+ * Number of 64 bit words needed to store a bit mask of n elements
+ */
+inline idx_t MaskWords(idx_t n) {
+  return (n + 63) / 64;
+}
+
+/**
+ * Call f(idx) for every bit set in the mask (in increasing order)
+ *
+ * @param mask packed bit mask, bit i of word w is element 64 * w + i
+ * @param words number of words in the mask
+ * @param f Function-like entity receiving the index of the set bit
+ */
+template<class _Fn>
+inline void ForEachMaskBit(const uint64_t* mask, idx_t words, _Fn f) {
+  for(idx_t w = 0; w < words; ++w) {
+    uint64_t bits = mask[w];
+    while(bits) {
+      f(w * 64 + __builtin_ctzll(bits));
+      bits &= bits - 1;
+    }
+  }
+}
+
+/**
+ * Mix the bits of a 64 bit value (splitmix64 finalizer), a stateless source of hash keys:
+ * different inputs give uncorrelated outputs
+ */
+inline uint64_t MixBits(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
 /**
  * Iterator for numeric type T to define ranges without backing arrays
  */
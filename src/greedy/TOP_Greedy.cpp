@@ -1,10 +1,20 @@
 #include "TOP_Greedy.hpp"
 #include "../common/Utils.hpp"
+#include "../common/TOP_Rating.hpp"
 
 #include <algorithm>
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <future>
+
+#include <ctpl_stl.h>
 
 using namespace std;
 
@@ -41,41 +51,323 @@ bool VerifyFeasibility(const TOP_Input& in, const TOP_Output& out, idx_t p);
  *
  * @param rng
  * @param totalQueuedAndSolvedSolutions
+ * @param minCount count under which the insertion is always accepted
+ * @param maxCount count over which the insertion is always rejected
  * @return true if the random generation of number allow the insertion
  */
-bool EvaluatePartial(std::mt19937& rng, int totalQueuedAndSolvedSolutions);
+bool EvaluatePartial(std::mt19937& rng, int totalQueuedAndSolvedSolutions, double minCount, double maxCount);
 
 #define EVALUATEPARTIAL_MINCOUNT_RNG 100.0
 #define EVALUATEPARTIAL_MAXCOUNT_RNG 600.0
 
+// With a deadline the branches are always accepted while the queue is within this fraction of the solutions
+// that fit the remaining time (and rejected over it), same proportion of the fixed thresholds
+#ifndef GREEDY_ANYTIME_MINCOUNT_FRACTION
+#define GREEDY_ANYTIME_MINCOUNT_FRACTION (EVALUATEPARTIAL_MINCOUNT_RNG / EVALUATEPARTIAL_MAXCOUNT_RNG)
+#endif
+
+// Points rated between two tests of the limits of an anytime run (a step can rate all the points)
+#ifndef GREEDY_ANYTIME_CHECK_POINTS
+#define GREEDY_ANYTIME_CHECK_POINTS 256
+#endif
+
+// Skip the maxDev of the range sweep that give the same run of the previous one (0 to solve all the cells)
+#ifndef GREEDY_RANGE_BREAKPOINTS
+#define GREEDY_RANGE_BREAKPOINTS 1
+#endif
+
+// Number of partial solutions kept in memory as starting points of the replays (besides the first one)
+#ifndef GREEDY_PARTIAL_CACHE
+#define GREEDY_PARTIAL_CACHE 64
+#endif
+
+// Memory budget in bytes of the partial solutions tree: when not 0 every branch is kept while the tree
+// fits the budget (and dropped otherwise) instead of being sampled by EvaluatePartial
+#ifndef GREEDY_PARTIAL_BUDGET
+#define GREEDY_PARTIAL_BUDGET 0
+#endif
+
 /**
- * Calculate one component of the rating assigned to one point. Estimate the possible profit losses
- * if one point isn't chosen, by summing all the point profits in the ellipse, which area is drawn
- * from the remaining time of the car and the point p. The result is a value without a unit of measure.
+ * Partial solutions still to solve (a stack) stored as a tree: each one keeps only the moves done from the
+ * solution it branched from (its parent). A partial solution is materialized by repeating the moves from the
+ * nearest ancestor kept in memory: the first solution and up to GREEDY_PARTIAL_CACHE solved ones with
+ * branches still pending. A node is freed when it is solved and all its branches are.
+ * The methods are synchronized, so the partial solutions can be stolen by other threads (see Steal).
  *
- * @param in constant input
- * @param out output that can be modified
- * @param p the point considered
- * @return point profits in the ellipse divided by all the points profit 
+ * Typical usage:
+ *   PartialTree partials(out);
+ *   while(!partials.Empty()) {
+ *     idx_t node = partials.Pop(sol);
+ *     auto start = sol.Mark();
+ *     ... partials.Push(node, sol, start) for each branch ...
+ *     sol.UndoTo(start); sol.Release();
+ *     partials.Cache(node, sol);
+ *   }
  */
-double NonChoicheCost(const TOP_Input& in, TOP_Output& out, idx_t car, idx_t p, double sumProfit);
+class PartialTree {
+  public:
+    PartialTree(const TOP_Output& root);
+
+    bool Empty() const { std::lock_guard<std::mutex> lock(mutex); return pending.empty(); }
+
+    // Number of partial solutions to solve
+    size_t Size() const { std::lock_guard<std::mutex> lock(mutex); return pending.size(); }
+
+    // Approximate memory used by the moves and by the materialized solutions
+    size_t Bytes() const { std::lock_guard<std::mutex> lock(mutex); return bytes; }
+
+    /**
+     * Restart the tree from a new first solution, all the nodes must be solved
+     *
+     * @param root the first partial solution to solve
+     * @return [void]
+     */
+    void Reset(const TOP_Output& root);
+
+    /**
+     * Add a partial solution on top of the stack
+     *
+     * @param parent node of the solution the branch started from
+     * @param out the branch, in the state of parent plus the moves recorded after start
+     * @param start mark opened on out in the state of parent
+     * @return [void]
+     */
+    void Push(idx_t parent, const TOP_Output& out, TOP_Output::trail_t start);
+
+    /**
+     * Substitute a partial solution not solved yet (same parameters of Push)
+     *
+     * @param idx position in the stack
+     * @return [void]
+     */
+    void Replace(size_t idx, idx_t parent, const TOP_Output& out, TOP_Output::trail_t start);
+
+    /**
+     * Remove the partial solution on top of the stack and materialize it
+     *
+     * @param out output overwritten with the partial solution
+     * @return the node of the partial solution (to pass to Cache when solved), -1 if the stack is empty
+     */
+    idx_t Pop(TOP_Output& out);
+
+    /**
+     * Remove the partial solution on the bottom of the stack (the oldest one, usually the one with
+     * more work left) and materialize it, it is solved outside of the tree
+     *
+     * @param out output overwritten with the partial solution
+     * @return false if the stack is empty
+     */
+    bool Steal(TOP_Output& out);
+
+    /**
+     * Mark the node as solved, out (in the state of the node) is kept as starting point of its branches
+     * if they are still pending and the cache is not full (in that case out is moved)
+     *
+     * @param node node returned by Pop
+     * @param out solution of the node in the state returned by Pop
+     * @return [void]
+     */
+    void Cache(idx_t node, TOP_Output& out);
+
+  private:
+    struct node_t {
+      idx_t parent;
+      std::vector<TOP_Output::TrailMove> moves; // From the state of parent
+      int refs; // Nodes pending or being solved in the subtree (itself included)
+      std::unique_ptr<TOP_Output> state; // Materialized solution (if cached)
+    };
+
+    std::vector<node_t> nodes;
+    std::deque<idx_t> pending; // Popped on the top, stolen from the bottom
+    size_t cached, bytes;
+    mutable std::mutex mutex;
+
+    idx_t NewNode(idx_t parent, const TOP_Output& out, TOP_Output::trail_t start);
+    void Materialize(idx_t node, TOP_Output& out) const;
+    void Unref(idx_t node);
+    static size_t StateBytes(const TOP_Output& out);
+};
 
 /**
- * Calculate the rating assigned to one point, which is made up of three components: the first is 
- * referring to the point profit on the mean of remaining points profit, the second one is referring 
- * to the remaining traveltime of the nearest car to the point and the impact it would have in entering 
- * that point and at least the cost (losses) of no choosing that point. All these components are weighted to adapt 
- * them to differents maps and their conformation.
+ * Ratings of the points during one PointToCarAssignment: the components that depend on a car (nearest car,
+ * travel time factor and loss) are kept until the car is moved, or until the loss is visited. The nearest cars
+ * and the travel time factors come from the rows of TOP_Ratings, recomputed in batch only for the moved cars, and
+ * the components are combined by TOP_Ratings::Combine. Only the profit component is computed for every point at
+ * each step.
  *
- * @param in constant input
- * @param out output that can be modified
- * @param p the point considered
- * @param wProfit weight that multiplies the first (profit) factor of the rating equation
- * @param wTime weight that multiplies the second (travel time) factor of the rating equation
- * @param wNonCost weight that multiplies the third (cost of no choice) factor of the rating equation
- * @return rating of the point p
+ * Typical usage:
+ *   GreedyRatings ratings(in, out);
+ *   while(...) {
+ *     ratings.Update(out); // After the moves of the previous step
+ *     ratings.RateAll(out, wProfit, wTime, wNonCost);
+ *     ... ratings.Score(p) ...
+ *   }
+ */
+class GreedyRatings {
+  public:
+    /**
+     * @param in constant input
+     * @param out initial state
+     * @param granularK if positive RateAll rates only the granularK nearest neighbors of the last points of the
+     *                  cars (all the points when none of them is feasible)
+     */
+    GreedyRatings(const TOP_Input& in, const TOP_Output& out, idx_t granularK = 0);
+
+    /**
+     * Start again from a state not derived by moves from the last update (same of a new object, the buffers
+     * are kept)
+     *
+     * @param out initial state
+     * @param granularK same of the constructor
+     * @return [void]
+     */
+    void Reset(const TOP_Output& out, idx_t granularK = 0);
+
+    /**
+     * Follow the moves done on out since the last update: the points that have a moved car as nearest
+     * car, or that are nearer to its new position, are invalidated together with the losses visited
+     *
+     * @param out output in a state reached by moves from the last update
+     * @return [void]
+     */
+    void Update(const TOP_Output& out);
+
+    /**
+     * Rating of a point for its nearest car (-INFINITY if visited or not reachable): the profit of the point on
+     * the mean profit of the points not visited, the travel time factor of the car and the profit of the first
+     * point the car could still reach after it. The components are recomputed only if invalidated.
+     *
+     * @param out current state
+     * @param p the point considered
+     * @param wProfit weight that multiplies the first (profit) factor of the rating equation
+     * @param wTime weight that multiplies the second (travel time) factor of the rating equation
+     * @param wNonCost weight that multiplies the third (cost of no choice) factor of the rating equation
+     * @return rating of the point p
+     */
+    double Rating(const TOP_Output& out, idx_t p, double wProfit, double wTime, double wNonCost);
+
+    /**
+     * Rate all the points with Rating (only the candidates with granularK), the results are read with Score
+     *
+     * @param out current state
+     * @param wProfit weight that multiplies the first (profit) factor of the rating equation
+     * @param wTime weight that multiplies the second (travel time) factor of the rating equation
+     * @param wNonCost weight that multiplies the third (cost of no choice) factor of the rating equation
+     * @param anytime if not null its limits are tested every GREEDY_ANYTIME_CHECK_POINTS points
+     * @return false if the limits expired before all the points were rated
+     */
+    bool RateAll(const TOP_Output& out, double wProfit, double wTime, double wNonCost, const GreedyAnytime* anytime);
+
+    // Rating of p computed by the last RateAll
+    double Score(idx_t p) const { return scores[p]; }
+
+  private:
+    struct rating_t {
+      idx_t car; // Nearest car (always updated)
+      idx_t loss; // First point reachable after p (valid if lossValid, otherwise the scan restarts after it)
+      double timeFactor;
+      bool valid; // Components computed for the current state of car
+      bool lossValid;
+    };
+
+    const TOP_Input& in;
+    idx_t granularK;
+    TOP_Ratings batch;
+    std::vector<rating_t> ratings;
+    std::vector<double> scores;
+    std::vector<uint64_t> carVersions; // Version of the cars at the last update
+    std::vector<bool> movedCars;
+};
+
+/**
+ * Points with the highest score of the last RateAll, the same of min_elements with so_negcmp but written in a
+ * vector reused by the steps
+ *
+ * @param ratings ratings of the step
+ * @param nPoints number of points
+ * @param maxPoints filled with the points (in index order)
+ * @return [void]
+ */
+void MaxScorePoints(const GreedyRatings& ratings, idx_t nPoints, std::vector<idx_t>& maxPoints);
+
+/**
+ * Sampling of the branches of one run (thresholds of EvaluatePartial) and its stop conditions
+ */
+struct BranchSampling {
+  int solved = 0; // Solutions solved in the run
+  double minCount = EVALUATEPARTIAL_MINCOUNT_RNG;
+  double maxCount = EVALUATEPARTIAL_MAXCOUNT_RNG;
+  const GreedyAnytime* anytime = nullptr;
+
+  /**
+   * Fit the thresholds to the solutions that can still be solved before the deadline, at the mean time per
+   * solution of the run
+   *
+   * @param elapsed seconds since the start of the run
+   * @param remaining seconds to the deadline
+   * @return [void]
+   */
+  void Adapt(double elapsed, double remaining);
+
+  bool Stopped() const { return anytime != nullptr && anytime->Expired(); }
+};
+
+// Longest sleep of an idle worker of GreedyParallelSolver, the deadline of the anytime mode is checked after it
+#ifndef GREEDY_PARALLEL_WAIT_MS
+#define GREEDY_PARALLEL_WAIT_MS 1
+#endif
+
+/**
+ * State shared by the workers of GreedyParallelSolver
  */
-double RatingChoice(const TOP_Input& in, TOP_Output& out, idx_t p, double wProfit, double wTime, double wNonCost);
+struct SharedBranches {
+  std::atomic<long> budget; // Branches that can still be queued
+  std::atomic<long> pending; // Partial solutions queued or being solved (the run ends at 0)
+  std::atomic<int> idle{0}; // Workers that found nothing to steal
+  std::atomic<uint64_t> events{0}; // Branches queued and solutions completed while some worker is idle
+  std::mutex waitMutex;
+  std::condition_variable changed;
+
+  /**
+   * Wake the idle workers, called after a branch is queued or pending drops. Nothing is locked when no worker
+   * is idle: a worker becomes idle before it looks for a branch to steal, so it cannot miss the change.
+   *
+   * @return [void]
+   */
+  void Notify() {
+    if(idle.load() > 0) {
+      {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        ++events;
+      }
+      changed.notify_all();
+    }
+  }
+};
+
+/**
+ * Scratch memory of GreedyArena, the objects that depend on the instance are built by Bind
+ */
+struct GreedyArena::Buffers {
+  const TOP_Input* in = nullptr; // Instance of the objects below
+  std::unique_ptr<TOP_Output> lastSol; // Solution being solved
+  std::unique_ptr<TOP_Output> result; // Output of the jobs of GreedyBatch
+  std::unique_ptr<PartialTree> partials;
+  std::unique_ptr<GreedyRatings> ratings; // Built by the first solution
+  std::vector<idx_t> inEllipse, maxPoints;
+  std::vector<uint64_t> ellipseMask;
+  std::vector<double> extra;
+  std::vector<bool> markedCars;
+
+  /**
+   * Ratings of a new solution starting from out
+   *
+   * @param out initial state of the solution
+   * @param granularK see GreedyRatings
+   * @return the ratings
+   */
+  GreedyRatings& Ratings(const TOP_Output& out, idx_t granularK);
+};
 
 /**
  * After choosing one point to insert in the nearest car, determinate if there is one (or more) point 
@@ -87,9 +379,14 @@ double RatingChoice(const TOP_Input& in, TOP_Output& out, idx_t p, double wProfi
  * @param out output that can be modified
  * @param car the car which path is modified 
  * @param maxDeviationAdmitted max deviation admitted on the path of the car
+ * @param nextMaxDeviation if not null it is lowered to the smallest detour above maxDeviationAdmitted of the candidates
+ * @param scratch buffers of the candidates
+ * @param anytime if not null the insertions stop when its limits expire
+ * @param granularK if positive only the granularK nearest neighbors of the previous point are candidates (not
+ *                  with nextMaxDeviation, the breakpoints need all the points of the ellipse)
  * @return integer value rappresentative of the number of points inserted by the recursive call
  */
-int InsertPoint(const TOP_Input &in, TOP_Output& out, idx_t car, double maxDeviationAdmitted);
+int InsertPoint(const TOP_Input &in, TOP_Output& out, idx_t car, double maxDeviationAdmitted, double* nextMaxDeviation, GreedyArena::Buffers& scratch, const GreedyAnytime* anytime = nullptr, idx_t granularK = 0);
 
 /**
  * Solve the problem with the greedy algorithm assigning to the point with the highest rating to its nearest 
@@ -99,19 +396,28 @@ int InsertPoint(const TOP_Input &in, TOP_Output& out, idx_t car, double maxDevia
  * If the partial_solution size is less than 100, all the instances are inserted. Between EVALUATEPARTIAL_MINCOUNT_RNG 
  * and EVALUATEPARTIAL_MAXCOUNT_RNG a random number generator is used to calculate the probability of insertion. 
  * Out of EVALUATEPARTIAL_MAXCOUNT_RNG all the partial solution are rejected.
+ * With a deadline the two thresholds follow the number of solutions that fit the time left (see BranchSampling).
  *
- * @param partial_solutions vector of partial solutions
+ * @param partials partial solutions to solve, the branches are added here
+ * @param node node of out in partials
+ * @param start mark opened on out in the state of node
  * @param in constant input
  * @param out constant output
+ * @param scratch buffers of the ratings and of the insertions
  * @param rng seed generator to save the solution and its informations
- * @param solvedSolutions parametr that allow to evaluate the insertion of one partial solution
+ * @param sampling thresholds that allow to evaluate the insertion of one partial solution, the solution stops
+ *                 (at any step) when the limits of the run expire
  * @param wProfit weight that multiplies the first (profit) factor of the rating equation
  * @param wTime weight that multiplies the second (travel time) factor of the rating equation
  * @param maxDeviationAdmitted max deviation admitted on the path of the car
  * @param wNonCost weight that multiplies the third (no choosing cost or losses) factor of the rating equation
+ * @param nextMaxDeviation if not null it is lowered to the smallest detour above maxDeviationAdmitted compared by InsertPoint
+ * @param shared if not null the branches are queued while its budget lasts (instead of EvaluatePartial)
+ * @param granularK if positive the candidates of the ratings and of InsertPoint are limited to the granularK
+ *                  nearest neighbors
  * @return [void]
  */
-void PointToCarAssignment(vector<TOP_Output>& partial_solutions, const TOP_Input& in, TOP_Output& out, std::mt19937& rng, int solvedSolutions, double wProfit, double wTime, double maxDeviationAdmitted, double wNonCost);
+void PointToCarAssignment(PartialTree& partials, idx_t node, TOP_Output::trail_t start, const TOP_Input& in, TOP_Output& out, GreedyArena::Buffers& scratch, std::mt19937& rng, const BranchSampling& sampling, double wProfit, double wTime, double maxDeviationAdmitted, double wNonCost, double* nextMaxDeviation, SharedBranches* shared = nullptr, idx_t granularK = 0);
 
 /******************
  * Implementation *
@@ -122,124 +428,334 @@ double CalculateDistance(const TOP_Input& in, const TOP_Output& out, idx_t p, id
 }
 
 bool VerifyFeasibility(const TOP_Input& in, const TOP_Output& out, idx_t p) {
-  NumberRange<idx_t> carIdxs(in.Cars());
+  // Verify that there is at least one car that can insert the point (bit test when the masks are updated)
+  return out.ReachableByAny(p);
+}
 
-  // Verify that there is at least one car that can insert the point
-  for(const auto& car : carIdxs) {
-    if(out.SimulateMoveCar(car, p).feasible) {
-      return true;
-    }
+GreedyAnytime GreedyAnytime::After(double seconds) {
+  GreedyAnytime anytime;
+  if(seconds > 0) {
+    anytime.deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+  }
+  return anytime;
+}
+
+bool GreedyAnytime::Expired() const {
+  if(cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+    return true;
+  }
+  return HasDeadline() && chrono::steady_clock::now() >= deadline;
+}
+
+void BranchSampling::Adapt(double elapsed, double remaining) {
+  if(elapsed <= 0) {
+    return; // No estimate yet
   }
-  return false; // Otherwise
+  double affordable = max(0.0, remaining) * solved / elapsed; // Solutions that fit the time left
+  minCount = solved + affordable * GREEDY_ANYTIME_MINCOUNT_FRACTION;
+  maxCount = solved + affordable;
 }
 
-bool EvaluatePartial(std::mt19937& rng, int totalQueuedAndSolvedSolutions) {
-  if(totalQueuedAndSolvedSolutions <= EVALUATEPARTIAL_MINCOUNT_RNG) {
+bool EvaluatePartial(std::mt19937& rng, int totalQueuedAndSolvedSolutions, double minCount, double maxCount) {
+  if(totalQueuedAndSolvedSolutions <= minCount) {
     return true;
   }
-  if(totalQueuedAndSolvedSolutions >= EVALUATEPARTIAL_MAXCOUNT_RNG) {
+  if(totalQueuedAndSolvedSolutions >= maxCount) {
     return false;
   }
 
   uniform_real_distribution<double> distribution(0.0, 1.0);
   double resultPerc = distribution(rng);
-  double passPerc = ((double)totalQueuedAndSolvedSolutions - EVALUATEPARTIAL_MINCOUNT_RNG) / (EVALUATEPARTIAL_MAXCOUNT_RNG - EVALUATEPARTIAL_MINCOUNT_RNG);
+  double passPerc = ((double)totalQueuedAndSolvedSolutions - minCount) / (maxCount - minCount);
   
   // cerr << "LOG: <" << resultPerc << " on " << passPerc << ">" << endl;
   return resultPerc >= passPerc;
 }
 
-double NonChoicheCost(const TOP_Input& in, TOP_Output& out, idx_t car, idx_t p, double sumProfit) {
-  double profitEllipse = 0.0;
+PartialTree::PartialTree(const TOP_Output& root) : cached(0), bytes(0) {
+  nodes.push_back({ -1, {}, 1, std::make_unique<TOP_Output>(root) }); // The root is always materialized
+  bytes += StateBytes(root);
+  pending.push_back(0);
+}
 
-  out.MoveCar(car, p);
-  for(idx_t point = 0; point < in.Points(); ++point) {
-    if(out.Visited(point)) { // If is not already visited
-      continue;
-    }
-    if(out.SimulateMoveCar(car, point).feasible) { // If can be reached by the selected car
-      profitEllipse += in.Point(point).Profit();
-      break;
+void PartialTree::Reset(const TOP_Output& root) {
+  std::lock_guard<std::mutex> lock(mutex);
+  nodes.clear();
+  pending.clear();
+  nodes.push_back({ -1, {}, 1, std::make_unique<TOP_Output>(root) });
+  cached = 0;
+  bytes = StateBytes(root);
+  pending.push_back(0);
+}
+
+idx_t PartialTree::NewNode(idx_t parent, const TOP_Output& out, TOP_Output::trail_t start) {
+  nodes.push_back({ parent, {}, 1, nullptr });
+  out.TrailMoves(start, nodes.back().moves);
+  bytes += nodes.back().moves.capacity() * sizeof(TOP_Output::TrailMove);
+  ++nodes[parent].refs;
+  return nodes.size() - 1;
+}
+
+void PartialTree::Push(idx_t parent, const TOP_Output& out, TOP_Output::trail_t start) {
+  std::lock_guard<std::mutex> lock(mutex);
+  pending.push_back(NewNode(parent, out, start));
+}
+
+void PartialTree::Replace(size_t idx, idx_t parent, const TOP_Output& out, TOP_Output::trail_t start) {
+  std::lock_guard<std::mutex> lock(mutex);
+  idx_t old = pending[idx];
+  pending[idx] = NewNode(parent, out, start);
+  Unref(old);
+}
+
+idx_t PartialTree::Pop(TOP_Output& out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if(pending.empty()) {
+    return -1;
+  }
+  idx_t node = pending.back();
+  pending.pop_back();
+  Materialize(node, out);
+  return node;
+}
+
+bool PartialTree::Steal(TOP_Output& out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if(pending.empty()) {
+    return false;
+  }
+  idx_t node = pending.front();
+  pending.pop_front();
+  Materialize(node, out);
+  Unref(node); // Solved by the thief
+  return true;
+}
+
+void PartialTree::Materialize(idx_t node, TOP_Output& out) const {
+  vector<idx_t> chain; // Nodes to replay, up to the nearest materialized ancestor
+  idx_t ancestor = node;
+  while(!nodes[ancestor].state) {
+    chain.push_back(ancestor);
+    ancestor = nodes[ancestor].parent;
+  }
+  out = *nodes[ancestor].state;
+  for(auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    out.ApplyMoves(nodes[*it].moves.data(), nodes[*it].moves.size());
+  }
+}
+
+void PartialTree::Cache(idx_t node, TOP_Output& out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  node_t& n = nodes[node];
+  if(!n.state && n.refs > 1 && cached < GREEDY_PARTIAL_CACHE) { // It has branches to solve
+    n.state = std::make_unique<TOP_Output>(std::move(out));
+    bytes += StateBytes(*n.state);
+    ++cached;
+  }
+  Unref(node); // Solved
+}
+
+void PartialTree::Unref(idx_t node) {
+  while(node >= 0 && --nodes[node].refs == 0) { // Free the subtrees completely solved
+    node_t& n = nodes[node];
+    bytes -= n.moves.capacity() * sizeof(TOP_Output::TrailMove);
+    vector<TOP_Output::TrailMove>().swap(n.moves);
+    if(n.state) {
+      bytes -= StateBytes(*n.state);
+      n.state.reset();
+      if(node != 0) {
+        --cached;
+      }
     }
+    node = n.parent;
   }
-  out.RollbackCar(car);
-  if(sumProfit == 0.0) {
-    return INFINITY;
+}
+
+size_t PartialTree::StateBytes(const TOP_Output& out) {
+  const TOP_Input& in = out.in; // Routes, visits, masks and per car data
+  return sizeof(TOP_Output) + in.Points() * (2 * sizeof(idx_t) + sizeof(int)) +
+    (in.Cars() + 1) * MaskWords(in.Points()) * sizeof(uint64_t) + in.Cars() * (4 * sizeof(uint64_t) + sizeof(dist_t));
+}
+
+GreedyRatings::GreedyRatings(const TOP_Input& in, const TOP_Output& out, idx_t granularK) : in(in), batch(in), ratings(in.Points()), scores(in.Points()), carVersions(in.Cars()), movedCars(in.Cars()) {
+  Reset(out, granularK);
+}
+
+void GreedyRatings::Reset(const TOP_Output& out, idx_t granularK) {
+  this->granularK = min(granularK, in.NeighborsK());
+  batch.Invalidate();
+  batch.Update(out);
+  for(idx_t p = 0; p < in.Points(); ++p) {
+    ratings[p] = { .car = batch.NearestCar(p), .loss = -1, .timeFactor = 0.0, .valid = false, .lossValid = false };
+  }
+  for(idx_t car = 0; car < in.Cars(); ++car) {
+    carVersions[car] = out.CarVersion(car);
   }
-  return profitEllipse / sumProfit;
 }
 
-double RatingChoice(const TOP_Input& in, TOP_Output& out, idx_t p, double wProfit, double wTime, double wNonCost) {
-  NumberRange<idx_t> carIdxs(in.Cars());
-  NumberRange<idx_t> pointIdxs(in.Points());
-  double profit = in.Point(p).Profit();
-  double notVisitedCount = 0.0;
-  double sumProfit = 0.0;
+void GreedyRatings::Update(const TOP_Output& out) {
+  bool moved = false;
+  for(idx_t car = 0; car < in.Cars(); ++car) {
+    movedCars[car] = out.CarVersion(car) != carVersions[car];
+    carVersions[car] = out.CarVersion(car);
+    moved = moved || movedCars[car];
+  }
 
-  // If the point is already visited or unfeasible, waste it by putting it in the vector's queue
-  if(out.Visited(p) || !VerifyFeasibility(in, out, p)) {                                                        
-    return -INFINITY;
+  if(moved) {
+    batch.Update(out); // Rows of the moved cars and nearest cars
+    for(idx_t p = 0; p < in.Points(); ++p) {
+      rating_t& r = ratings[p];
+      if(out.Visited(p)) {
+        continue; // Never rated again
+      }
+      if(movedCars[r.car] || batch.NearestCar(p) != r.car) { // Its car has moved or another car is now the nearest
+        r.car = batch.NearestCar(p);
+        r.valid = false;
+      }
+    }
   }
-  
-  // Factor dependent on the profit   
-  for(const auto& p : pointIdxs) { 
-    if(!out.Visited(p)) {
-      sumProfit += in.Point(p).Profit();
-      ++notVisitedCount;
+
+  for(idx_t p = 0; p < in.Points(); ++p) { // The losses visited by the moves
+    rating_t& r = ratings[p];
+    if(r.valid && r.lossValid && r.loss >= 0 && out.Visited(r.loss)) {
+      r.lossValid = false;
     }
   }
+}
+
+double GreedyRatings::Rating(const TOP_Output& out, idx_t p, double wProfit, double wTime, double wNonCost) {
+  if(out.Visited(p) || !VerifyFeasibility(in, out, p)) { // Wasted at the end of the ranking
+    return -INFINITY;
+  }
 
-  double meanProfit;
-  if(notVisitedCount == 0.0) {
-    meanProfit = INFINITY;
+  rating_t& r = ratings[p];
+  if(!r.valid) {
+    r.timeFactor = batch.TimeFactor(r.car, p);
+    r.loss = batch.FirstReachableAfter(out, r.car, p, 0);
+    r.valid = r.lossValid = true;
+  } else if(!r.lossValid) { // The points before the old loss are still visited or not reachable
+    r.loss = batch.FirstReachableAfter(out, r.car, p, r.loss + 1);
+    r.lossValid = true;
   }
-  else {
-    meanProfit = sumProfit / notVisitedCount;
+  return TOP_Ratings::Combine(out, p, r.timeFactor, r.loss < 0 ? 0.0 : in.Point(r.loss).Profit(), wProfit, wTime, wNonCost);
+}
+
+bool GreedyRatings::RateAll(const TOP_Output& out, double wProfit, double wTime, double wNonCost, const GreedyAnytime* anytime) {
+  if(granularK > 0) { // Only the nearest neighbors of the last points of the cars
+    fill(scores.begin(), scores.end(), -INFINITY);
+    bool found = false;
+    for(idx_t car = 0; car < in.Cars(); ++car) {
+      const idx_t* near = in.Neighbors(out.CarPoint(car));
+      for(idx_t i = 0; i < granularK; ++i) {
+        scores[near[i]] = Rating(out, near[i], wProfit, wTime, wNonCost);
+        found = found || scores[near[i]] != -INFINITY;
+      }
+    }
+    if(found) {
+      return true;
+    }
   }
 
-  // Factor dependent on the traveltime
-  idx_t chosenCar = *min_element(carIdxs.begin(), carIdxs.end(), [&in, &out, &p](idx_t c1, idx_t c2) {
-    return CalculateDistance(in, out, p, c1) < CalculateDistance(in, out, p, c2);
-  });
-  double gamma = out.TravelTime(chosenCar) / in.MaxTime();
+  for(idx_t p = 0; p < in.Points(); ++p) {
+    if(anytime != nullptr && p % GREEDY_ANYTIME_CHECK_POINTS == 0 && anytime->Expired()) {
+      return false; // The ratings computed are kept for the next call
+    }
+    scores[p] = Rating(out, p, wProfit, wTime, wNonCost);
+  }
+  return true;
+}
 
-  double extraTravelTimeNorm;
-  if(in.MaxTime() - out.TravelTime(chosenCar) == 0.0) {
-    extraTravelTimeNorm = INFINITY;
+void MaxScorePoints(const GreedyRatings& ratings, idx_t nPoints, vector<idx_t>& maxPoints) {
+  maxPoints.clear();
+  if(nPoints == 0) {
+    return;
   }
-  else {
-    extraTravelTimeNorm = out.SimulateMoveCar(chosenCar, p).extraTravelTime / (in.MaxTime() - out.TravelTime(chosenCar));
+  maxPoints.push_back(0);
+  double maxValue = ratings.Score(0);
+  for(idx_t p = 1; p < nPoints; ++p) {
+    double value = ratings.Score(p);
+    double order = so_negcmp<double>(value, maxValue); // NaN (both -INFINITY) is neither a new maximum nor a tie
+    if(order < 0) {
+      maxPoints.clear();
+      maxValue = value;
+      maxPoints.push_back(p);
+    } else if(order == 0) {
+      maxPoints.push_back(p);
+    }
   }
-  
-  // Factor dependent on the cost (losses) of chosing another point
-  double noChoice = NonChoicheCost(in, out, chosenCar, p, sumProfit);
+}
 
-  return (profit / meanProfit) * wProfit - (gamma * extraTravelTimeNorm) * wTime + noChoice * wNonCost;
+GreedyRatings& GreedyArena::Buffers::Ratings(const TOP_Output& out, idx_t granularK) {
+  if(!ratings) {
+    ratings = std::make_unique<GreedyRatings>(*in, out, granularK);
+  } else {
+    ratings->Reset(out, granularK);
+  }
+  return *ratings;
 }
 
-int InsertPoint(const TOP_Input &in, TOP_Output& out, idx_t car, double maxDeviationAdmitted) {
-  NumberRange<idx_t> pointIdxs(in.Points());
-  vector<idx_t> inEllipse;
+GreedyArena::GreedyArena() : buffers(std::make_unique<Buffers>()) {}
+
+GreedyArena::~GreedyArena() = default;
+
+GreedyArena::Buffers& GreedyArena::Bind(const TOP_Input& in) {
+  if(buffers->in != &in) {
+    Reset();
+    buffers->in = &in;
+    buffers->lastSol = std::make_unique<TOP_Output>(in);
+    buffers->result = std::make_unique<TOP_Output>(in);
+  }
+  return *buffers;
+}
+
+void GreedyArena::Reset() {
+  buffers = std::make_unique<Buffers>();
+}
+
+int InsertPoint(const TOP_Input &in, TOP_Output& out, idx_t car, double maxDeviationAdmitted, double* nextMaxDeviation, GreedyArena::Buffers& scratch, const GreedyAnytime* anytime, idx_t granularK) {
+  if(anytime != nullptr && anytime->Expired()) {
+    return 0; // The solution is feasible after every insertion
+  }
+  vector<idx_t>& inEllipse = scratch.inEllipse; // Not used after the recursive call
+  inEllipse.clear();
+  granularK = nextMaxDeviation == nullptr ? min(granularK, in.NeighborsK()) : 0;
 
   if(out.CarPoint(car) != in.StartPoint()) { // Only if the car has already move (debugging porpouse)
 
-    // Add to the vector only the points which deviation from the path is admitted
-    for(idx_t point = 1; point < (in.Points() - 1); ++point) {
-      double ellipseDist = 
-        in.Distance(out.CarPoint(car), point) + 
-        in.Distance(out.Hop(car, out.Hops(car) - 2), point) - 
-        in.Distance(out.CarPoint(car), out.Hop(car, out.Hops(car) - 2));
-      
-      // cerr <<
-      //   "LOG: from " << out.Hop(car, out.Hops(car) - 2) << " to " <<
-      //   out.CarPoint(car) << " taking " << point << ": " << ellipseDist << endl;
-
-      if(!out.Visited(point) && ellipseDist <= maxDeviationAdmitted) {
-        inEllipse.push_back(point);
-        // cerr << "LOG: " << point << "and " << ellipseDist << endl;
-        // cerr <<
-        //   "LOG: " << in.Point(out.CarPoint(car)).Distance(in.Point(point)) << " " <<
-        //   in.Point(out.Hop(car, out.Hops(car)-2)).Distance(in.Point(point)) << " " << maxDeviationAdmitted << endl;
+    if(granularK > 0) { // The first neighbor of the previous point in the ellipse is the nearest candidate
+      idx_t prevNode = out.Hop(car, out.Hops(car) - 2);
+      const idx_t* near = in.Neighbors(prevNode);
+      for(idx_t i = 0; i < granularK && inEllipse.empty(); ++i) {
+        idx_t point = near[i];
+        if(point >= 1 && point < (in.Points() - 1) && !out.Visited(point) && in.ExtraDistance(out.CarPoint(car), point, prevNode) <= maxDeviationAdmitted) {
+          inEllipse.push_back(point);
+        }
+      }
+    } else { // Add to the vector only the points which deviation from the path is admitted
+      vector<uint64_t>& ellipseMask = scratch.ellipseMask;
+      ellipseMask.assign(MaskWords(in.Points()), 0);
+      in.DetourMask(out.CarPoint(car), out.Hop(car, out.Hops(car) - 2), 0.0, maxDeviationAdmitted, ellipseMask.data());
+      ForEachMaskBit(ellipseMask.data(), ellipseMask.size(), [&in, &out, &inEllipse](idx_t point) {
+        if(point >= 1 && point < (in.Points() - 1) && !out.Visited(point)) {
+          inEllipse.push_back(point);
+        }
+      });
+    }
+
+    if(nextMaxDeviation != nullptr) {
+      // A point left out changes the choice only if it would be the nearest of the ellipse (ties included)
+      idx_t prevNode = out.Hop(car, out.Hops(car) - 2);
+      double nearest = INFINITY;
+      for(idx_t point : inEllipse) {
+        nearest = min(nearest, in.Distance(point, prevNode));
+      }
+      vector<double>& extra = scratch.extra;
+      extra.resize(in.Points());
+      in.ExtraDistances(out.CarPoint(car), prevNode, extra.data());
+      for(idx_t point = 1; point < in.Points() - 1; ++point) {
+        if(extra[point] > maxDeviationAdmitted && extra[point] < *nextMaxDeviation && !out.Visited(point) && in.Distance(point, prevNode) <= nearest) {
+          *nextMaxDeviation = extra[point];
+        }
       }
     }
 
@@ -261,16 +777,16 @@ int InsertPoint(const TOP_Input &in, TOP_Output& out, idx_t car, double maxDevia
       idx_t node = inEllipse.front();
       // cerr << "LOG: Point choose: " << node << " into car " << car << endl;
 
-      double dist =
-        out.TravelTime(car) -
-        in.Distance(out.CarPoint(car), in.EndPoint()) +
-        in.Distance(out.CarPoint(car), node) +
-        in.Distance(node, lastNode) +
-        in.Distance(lastNode, in.EndPoint());
+      dist_t dist =
+        out.TravelDist(car) -
+        in.Dist(out.CarPoint(car), in.EndPoint()) +
+        in.Dist(out.CarPoint(car), node) +
+        in.Dist(node, lastNode) +
+        in.Dist(lastNode, in.EndPoint());
       // cerr << "LOG: Distance of point: " << node << " -> " << dist << " on " << in.MaxTime() << endl;
 
       // Verify if it is possible to insert the point into the car path, otherwise throw an error 
-      if(dist <= in.MaxTime()) {
+      if(dist <= in.MaxDist()) {
         if(!out.MoveCar(car, node, false).feasible) {
           throw runtime_error("ERROR: Insert failed but check feasibility passed");
         }
@@ -279,7 +795,7 @@ int InsertPoint(const TOP_Input &in, TOP_Output& out, idx_t car, double maxDevia
           if(!out.MoveCar(car, lastNode, false).feasible) {
             throw runtime_error("ERROR: Cannot reinsert the last point but check feasibility passed");
           }
-          return 1 + InsertPoint(in, out, car, maxDeviationAdmitted);
+          return 1 + InsertPoint(in, out, car, maxDeviationAdmitted, nextMaxDeviation, scratch, anytime, granularK);
         }
       } 
       else { // If there isn't enough travel time left
@@ -300,20 +816,23 @@ int InsertPoint(const TOP_Input &in, TOP_Output& out, idx_t car, double maxDevia
   }
 }
 
-void PointToCarAssignment(vector<TOP_Output>& partial_solutions, const TOP_Input& in, TOP_Output& out, std::mt19937& rng, int solvedSolutions, double wProfit, double wTime, double maxDeviationAdmitted, double wNonCost) {
+void PointToCarAssignment(PartialTree& partials, idx_t node, TOP_Output::trail_t start, const TOP_Input& in, TOP_Output& out, GreedyArena::Buffers& scratch, std::mt19937& rng, const BranchSampling& sampling, double wProfit, double wTime, double maxDeviationAdmitted, double wNonCost, double* nextMaxDeviation, SharedBranches* shared, idx_t granularK) {
   NumberRange<idx_t> carIdxs(in.Cars());
   NumberRange<idx_t> pointIdxs(in.Points());
-  vector<bool> markedCars(in.Cars());
+  vector<bool>& markedCars = scratch.markedCars;
+  markedCars.assign(in.Cars(), false);
+  GreedyRatings& ratings = scratch.Ratings(out, granularK);
 
-  while(true) {
+  while(!sampling.Stopped()) {
+    out.UpdateReachable(); // Only the cars moved in the previous step
+    ratings.Update(out);
     
     // Look for the best points insertion based on the rating of the point (to nearest car)
-    auto maxPoints = min_elements(in.Points(), so_negcmp<double>, [&in, &out, &wProfit, &wTime, &wNonCost] (idx_t p) -> double {
-      if(!VerifyFeasibility(in, out, p)) {
-        return -INFINITY;
-      }
-      return RatingChoice(in, out, p, wProfit, wTime, wNonCost);
-    });
+    if(!ratings.RateAll(out, wProfit, wTime, wNonCost, sampling.anytime)) { // Rating vector of all the points
+      break;
+    }
+    vector<idx_t>& maxPoints = scratch.maxPoints;
+    MaxScorePoints(ratings, in.Points(), maxPoints);
     // cerr << "LOG: Size " << maxPoints.size() << endl;
 
     // Choose a random point as main path (tie breaking)
@@ -338,31 +857,44 @@ void PointToCarAssignment(vector<TOP_Output>& partial_solutions, const TOP_Input
       }
 
       // Evaluate the partial solution
+      auto mark = out.Mark();
       if(!out.Visited(chosenPoint) && out.MoveCar(chosenCar, chosenPoint, false).feasible) { 
-        int backhops = InsertPoint(in, out, chosenCar, maxDeviationAdmitted);
+        InsertPoint(in, out, chosenCar, maxDeviationAdmitted, nextMaxDeviation, scratch, sampling.anytime, granularK);
         
         // cerr << "LOG: partialCounter: " << partialCounter << endl; 
         
+        if(shared != nullptr) { // Keep the branches while the budget of the run lasts
+          if(shared->budget.fetch_sub(1, std::memory_order_relaxed) > 0) {
+            shared->pending.fetch_add(1);
+            partials.Push(node, out, start);
+            shared->Notify();
+          }
+        }
+#if GREEDY_PARTIAL_BUDGET
+        else if(partials.Bytes() <= GREEDY_PARTIAL_BUDGET) { // Keep all the branches that fit the memory
+          partials.Push(node, out, start);
+        }
+#else
         // Evaluate if insert the partial solution based on the partial solutions processed
-        if(EvaluatePartial(rng, solvedSolutions + partial_solutions.size())) {
-          partial_solutions.push_back(out);
+        else if(EvaluatePartial(rng, sampling.solved + partials.Size(), sampling.minCount, sampling.maxCount)) {
+          partials.Push(node, out, start);
         } else {
           // Reject or substitute
           // Probability of rejection on subsequent calls sould be uniform (even though order is dependent, and sort of depth first)
           // To solve this sould use random to select next partial solution, but this can reduce tree traversal
           // Because initial splits will be randomized
           // For semplicity an ordered evaluation is preferred and 50% rejection or random substitution is applied
-          if(uniform_int_distribution<int>(0, 1)(rng) && partial_solutions.size() > 0) {
-            idx_t subedPartial = uniform_int_distribution<idx_t>(0, partial_solutions.size()-1)(rng);
-            partial_solutions[subedPartial] = out;
+          if(uniform_int_distribution<int>(0, 1)(rng) && partials.Size() > 0) {
+            idx_t subedPartial = uniform_int_distribution<idx_t>(0, partials.Size()-1)(rng);
+            partials.Replace(subedPartial, node, out, start);
           }
         }
+#endif
         
-        // Rollback InsertPoint
-        for(int j = 0; j <= backhops; j++){
-          out.RollbackCar(chosenCar);
-        }  
+        // Rollback the partial solution
+        out.UndoTo(mark);
       }
+      out.Release();
     }
 
     idx_t chosenPoint = maxPoints[mainBranchPoint];
@@ -387,7 +919,7 @@ void PointToCarAssignment(vector<TOP_Output>& partial_solutions, const TOP_Input
     }
     else {
       // cerr << "LOG: Hops before : " << out.Hops(chosenCar) << endl;
-      InsertPoint(in, out, chosenCar, maxDeviationAdmitted);
+      InsertPoint(in, out, chosenCar, maxDeviationAdmitted, nextMaxDeviation, scratch, sampling.anytime, granularK);
       // cerr << "LOG: Hops after : " << out.Hops(chosenCar) << endl;
     }
   }
@@ -401,23 +933,37 @@ void PointToCarAssignment(vector<TOP_Output>& partial_solutions, const TOP_Input
   // cerr << "LOG: counter of partial solution inserted " << partialCounter << endl;
 }
 
-void GreedySolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, double wProfit, double wTime, double maxDeviationAdmitted, double wNonCost) {
-  vector<TOP_Output> partial_solutions;
-  int solvedSolutions = 0;
-
-  partial_solutions.clear(); // Start solving
-  partial_solutions.push_back(out);
+void GreedySolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, double wProfit, double wTime, double maxDeviationAdmitted, double wNonCost, double* nextMaxDeviation, const GreedyAnytime* anytime, idx_t granularK, GreedyArena* arena) {
+  std::unique_ptr<GreedyArena> runArena;
+  if(arena == nullptr) { // Only for this run
+    runArena = std::make_unique<GreedyArena>();
+    arena = runArena.get();
+  }
+  GreedyArena::Buffers& scratch = arena->Bind(in);
+  if(!scratch.partials) { // Start solving
+    scratch.partials = std::make_unique<PartialTree>(out);
+  } else {
+    scratch.partials->Reset(out);
+  }
+  PartialTree& partials = *scratch.partials;
+  TOP_Output& lastSol = *scratch.lastSol;
+  BranchSampling sampling;
+  sampling.anytime = anytime;
+  auto begin = chrono::steady_clock::now();
 
-  while(!partial_solutions.empty()) { // While all the partial solution are solved
+  while(!partials.Empty() && !sampling.Stopped()) { // While all the partial solution are solved
     
-    auto lastSol = partial_solutions.back(); // To next partial solution
-    partial_solutions.pop_back();
+    idx_t node = partials.Pop(lastSol); // To next partial solution
+    auto start = lastSol.Mark(); // The branches are recorded from here
     
-    PointToCarAssignment(partial_solutions, in, lastSol, rng, solvedSolutions, wProfit, wTime, maxDeviationAdmitted, wNonCost); // Solve
-    ++solvedSolutions; 
+    PointToCarAssignment(partials, node, start, in, lastSol, scratch, rng, sampling, wProfit, wTime, maxDeviationAdmitted, wNonCost, nextMaxDeviation, nullptr, granularK); // Solve
+    ++sampling.solved;
 
     if(lastSol.PointProfit() > out.PointProfit()) { // Update the best solution found
       out = lastSol;
+      if(anytime != nullptr && anytime->onImprove) {
+        anytime->onImprove(out);
+      }
       
       // if(out.PointProfit() != 0) { // Print solution improvement
       //   cerr << 
@@ -426,18 +972,130 @@ void GreedySolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, doubl
       //     " % from the previous one" << endl;
       // }
     }
+
+    if(anytime != nullptr && anytime->HasDeadline()) { // Sample the branches for the time left
+      auto now = chrono::steady_clock::now();
+      sampling.Adapt(chrono::duration<double>(now - begin).count(), chrono::duration<double>(anytime->deadline - now).count());
+    }
+
+    lastSol.UndoTo(start); // Back to the state of the node for its branches
+    lastSol.Release();
+    partials.Cache(node, lastSol);
+  }
+  // cerr << "LOG: Currently solved the instance " << sampling.solved << " times" << endl;
+}
+
+void GreedyParallelSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, double wProfit, double wTime, double maxDeviationAdmitted, double wNonCost, int nThreads, long branchBudget, const GreedyAnytime* anytime, idx_t granularK) {
+  if(nThreads <= 0) {
+    nThreads = max(1U, thread::hardware_concurrency());
+  }
+
+  SharedBranches shared;
+  shared.budget = branchBudget;
+  shared.pending = 1; // The first solution
+  vector<unique_ptr<PartialTree>> trees;
+  vector<GreedyArena> arenas(nThreads);
+  vector<mt19937> rngs;
+  for(int w = 0; w < nThreads; ++w) {
+    trees.push_back(std::make_unique<PartialTree>(out));
+    rngs.emplace_back(rng());
+  }
+  TOP_Output first(in);
+  for(int w = 1; w < nThreads; ++w) {
+    trees[w]->Cache(trees[w]->Pop(first), first); // Only the first worker starts, the others steal
+  }
+
+  // Best solution shared by the workers, the profit is read without locking
+  atomic<int> bestProfit(out.PointProfit());
+  std::mutex bestMutex;
+  BranchSampling sampling; // Only the stop conditions, the branches are limited by the budget
+  sampling.anytime = anytime;
+  atomic<bool> failed(false); // A worker has thrown, its branches are never completed
+  vector<std::future<void>> results;
+  {
+    ctpl::thread_pool pool(nThreads);
+    for(int w = 0; w < nThreads; ++w) {
+      results.push_back(pool.push([&, w](int) {
+        try {
+          PartialTree& tree = *trees[w];
+          GreedyArena::Buffers& scratch = arenas[w].Bind(in);
+          TOP_Output& lastSol = *scratch.lastSol;
+          while(shared.pending.load() > 0 && !sampling.Stopped() && !failed.load()) {
+            idx_t node = tree.Pop(lastSol);
+            if(node < 0) { // Steal the oldest partial solution of another worker
+              shared.idle.fetch_add(1);
+              uint64_t seen = shared.events.load();
+              bool stolen = false;
+              for(int k = 1; k < nThreads && !stolen; ++k) {
+                stolen = trees[(w + k) % nThreads]->Steal(lastSol);
+              }
+              if(!stolen) { // Sleep until a branch is queued or a solution is completed (or the deadline is checked)
+                std::unique_lock<std::mutex> lock(shared.waitMutex);
+                shared.changed.wait_for(lock, chrono::milliseconds(GREEDY_PARALLEL_WAIT_MS), [&shared, &failed, seen] {
+                  return shared.events.load() != seen || shared.pending.load() == 0 || failed.load();
+                });
+              }
+              shared.idle.fetch_sub(1);
+              if(stolen) {
+                tree.Reset(lastSol);
+              }
+              continue;
+            }
+
+            auto start = lastSol.Mark();
+            PointToCarAssignment(tree, node, start, in, lastSol, scratch, rngs[w], sampling, wProfit, wTime, maxDeviationAdmitted, wNonCost, nullptr, &shared, granularK);
+
+            if(lastSol.PointProfit() > bestProfit.load()) { // Update the best solution found
+              std::lock_guard<std::mutex> lock(bestMutex);
+              if(lastSol.PointProfit() > bestProfit.load()) {
+                out = lastSol;
+                bestProfit = lastSol.PointProfit();
+                if(anytime != nullptr && anytime->onImprove) {
+                  anytime->onImprove(out);
+                }
+              }
+            }
+
+            lastSol.UndoTo(start);
+            lastSol.Release();
+            tree.Cache(node, lastSol);
+            shared.pending.fetch_sub(1); // After its branches are queued
+            shared.Notify();
+          }
+        } catch(...) {
+          failed = true; // Stop the other workers
+          shared.Notify();
+          throw;
+        }
+      }));
+    }
+    pool.stop(true);
+  }
+  for(auto& result : results) {
+    result.get(); // Throw the exception of the first worker failed
   }
-  // cerr << "LOG: Currently solved the instance " << solvedSolutions << " times" << endl;
 }
 
 struct rangeParams_t {
   double wTime, maxDev, wNonCost;
 };
 
-void GreedyRangeSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, bool extendedRanges, bool saveBestParams, std::ostream& log) {
-  TOP_Output curr_out(in);
-  int bestProfit = 0;
-  
+/**
+ * Seed of one row (wTime, wNonCost) of the range sweep, it depends only on the seed of the sweep and on the
+ * row coordinates so the result does not depend on the number of threads (MixBits).
+ * All the maxDev of a row share the seed, so the runs that compare the detours in the same way are identical.
+ *
+ * @param seed seed of the sweep
+ * @param wTimeIdx index of wTime in the sweep
+ * @param wNonCostIdx index of wNonCost in the sweep
+ * @return the seed of the row
+ */
+static mt19937::result_type RowSeed(uint64_t seed, int wTimeIdx, int wNonCostIdx) {
+  uint64_t key = (uint64_t)wTimeIdx << 32 | (uint64_t)wNonCostIdx;
+  return (mt19937::result_type)MixBits(seed + 0x9E3779B97F4A7C15ULL * (1 + key));
+}
+
+void GreedyRangeSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, bool extendedRanges, bool saveBestParams, std::ostream& log, int nThreads) {
   constexpr double NORM_WTIME_MIN = 0.1;
   constexpr double NORM_WTIME_MAX = 1.2;
   constexpr double NORM_WTIME_STEP = 0.1;
@@ -455,33 +1113,103 @@ void GreedyRangeSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng,
   double wTimeStep = NORM_WTIME_STEP;
   double wNonCostStep = NORM_WNONCOST_STEP;
 
-  rangeParams_t best = { .wTime = -1, .maxDev = -1, .wNonCost = -1 };
+  // Enumerate the cells of the grid (same values of the steps accumulated by the serial sweep)
+  uint64_t sweepSeed = rng();
+  vector<rangeParams_t> cells;
+  vector<size_t> rowStart; // Cells of row r are in [rowStart[r], rowStart[r + 1])
+  vector<mt19937::result_type> rowSeeds;
   rangeParams_t curr;
-
-  for(curr.wTime = NORM_WTIME_MIN; curr.wTime <= (extendedRanges ? EXT_WTIME_MAX : NORM_WTIME_MAX); curr.wTime += wTimeStep) {
+  int wTimeIdx = 0;
+  for(curr.wTime = NORM_WTIME_MIN; curr.wTime <= (extendedRanges ? EXT_WTIME_MAX : NORM_WTIME_MAX); curr.wTime += wTimeStep, ++wTimeIdx) {
     if(extendedRanges && curr.wTime > NORM_WTIME_MAX && curr.wTime < EXT_WTIME_MIN) {
       curr.wTime = EXT_WTIME_MIN;
       wTimeStep = EXT_WTIME_STEP;
     }
 
-    for(curr.wNonCost = NORM_WNONCOST_MIN; curr.wNonCost <= (extendedRanges ? EXT_WNONCOST_MAX : NORM_WNONCOST_MAX); curr.wNonCost += wNonCostStep) {
+    int wNonCostIdx = 0;
+    for(curr.wNonCost = NORM_WNONCOST_MIN; curr.wNonCost <= (extendedRanges ? EXT_WNONCOST_MAX : NORM_WNONCOST_MAX); curr.wNonCost += wNonCostStep, ++wNonCostIdx) {
       if(extendedRanges && curr.wNonCost > NORM_WNONCOST_MAX && curr.wNonCost < EXT_WNONCOST_MIN) {
         curr.wNonCost = EXT_WNONCOST_MIN;
         wNonCostStep = EXT_WNONCOST_STEP;
       }
 
+      rowStart.push_back(cells.size());
+      rowSeeds.push_back(RowSeed(sweepSeed, wTimeIdx, wNonCostIdx));
       for(curr.maxDev = 0; curr.maxDev <= 6; curr.maxDev += 0.01) {
-        curr_out.Clear();
-        GreedySolver(in, curr_out, rng, 1, curr.wTime, curr.maxDev, curr.wNonCost);
-        if(curr_out.PointProfit() > bestProfit) {
-          out = curr_out;
-          best = curr;
-          bestProfit = out.PointProfit();
-          log << "Found better solution: " << bestProfit << " with (" << best.wTime << ", " << best.maxDev << ", " << best.wNonCost << ")" << std::endl;
-        }
+        cells.push_back(curr);
       }
     }
   }
+  rowStart.push_back(cells.size());
+
+  if(nThreads <= 0) {
+    nThreads = max(1U, thread::hardware_concurrency());
+  }
+
+  // Best of each worker, the ties are broken by the first cell in the sweep order
+  struct workerBest_t {
+    int profit;
+    size_t cell;
+    TOP_Output out;
+  };
+  vector<TOP_Output> workerOuts(nThreads, TOP_Output(in));
+  vector<GreedyArena> workerArenas(nThreads);
+  vector<workerBest_t> workerBests(nThreads, { 0, cells.size(), TOP_Output(in) });
+  vector<int> profits(cells.size());
+  vector<std::future<void>> results;
+  {
+    ctpl::thread_pool pool(nThreads);
+    for(size_t row = 0; row + 1 < rowStart.size(); ++row) {
+      results.push_back(pool.push([&in, &cells, &rowStart, &rowSeeds, &profits, &workerOuts, &workerArenas, &workerBests, row](int id) {
+        TOP_Output& curr_out = workerOuts[id];
+        double nextMaxDev = -INFINITY; // The cells below give the same run of the last solved one
+        for(size_t cell = rowStart[row]; cell < rowStart[row + 1]; ++cell) {
+#if GREEDY_RANGE_BREAKPOINTS
+          if(cells[cell].maxDev < nextMaxDev) {
+            profits[cell] = profits[cell - 1];
+            continue;
+          }
+          nextMaxDev = INFINITY;
+#endif
+          mt19937 rowRng(rowSeeds[row]);
+          curr_out.Clear();
+          GreedySolver(in, curr_out, rowRng, 1, cells[cell].wTime, cells[cell].maxDev, cells[cell].wNonCost, &nextMaxDev, nullptr, 0, &workerArenas[id]);
+          profits[cell] = curr_out.PointProfit();
+
+          workerBest_t& best = workerBests[id];
+          if(profits[cell] > best.profit || (profits[cell] == best.profit && profits[cell] > 0 && cell < best.cell)) {
+            best.profit = profits[cell];
+            best.cell = cell;
+            best.out = curr_out;
+          }
+        }
+      }));
+    }
+    pool.stop(true); // Wait all the rows
+  }
+  for(auto& result : results) {
+    result.get(); // Throw the exception of the first row failed
+  }
+
+  // Reduce to the best and report the improvements in the sweep order
+  int bestProfit = 0;
+  for(size_t cell = 0; cell < cells.size(); ++cell) {
+    if(profits[cell] > bestProfit) {
+      bestProfit = profits[cell];
+      log << "Found better solution: " << bestProfit << " with (" << cells[cell].wTime << ", " << cells[cell].maxDev << ", " << cells[cell].wNonCost << ")" << std::endl;
+    }
+  }
+  rangeParams_t best = { .wTime = -1, .maxDev = -1, .wNonCost = -1 };
+  const workerBest_t* bestWorker = nullptr;
+  for(const auto& worker : workerBests) {
+    if(worker.profit == bestProfit && bestProfit > 0 && (bestWorker == nullptr || worker.cell < bestWorker->cell)) {
+      bestWorker = &worker;
+    }
+  }
+  if(bestWorker != nullptr) {
+    out = bestWorker->out;
+    best = cells[bestWorker->cell];
+  }
 
   if(saveBestParams) {
     ofstream ofs(GetGreedyBestParamsPath(in.name));
@@ -508,3 +1236,63 @@ void GreedyRangeSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng,
     ofs << endl;
   }
 }
+
+void GreedyAdaptiveSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, const std::vector<ParamDim>& dims, int minDepth, int maxDepth, std::ostream& log, int nThreads) {
+  if(dims.size() != 3) {
+    throw logic_error("The adaptive greedy needs the ranges of wTime, maxDev and wNonCost");
+  }
+
+  mt19937::result_type seed = rng();
+  ParamSearch search(dims, minDepth, maxDepth);
+  search.Run([&in, seed](const ParamSearch::point_t& x) {
+    mt19937 pointRng(seed);
+    TOP_Output pointOut(in);
+    GreedySolver(in, pointOut, pointRng, 1, x[0], x[1], x[2]);
+    return (double)pointOut.PointProfit();
+  }, nThreads);
+
+  ParamSearch::index_t bestIdx;
+  double bestProfit;
+  if(!search.Best(bestIdx, bestProfit)) {
+    return;
+  }
+  auto best = search.Point(bestIdx);
+  mt19937 bestRng(seed); // Solve again the best point to get its solution
+  TOP_Output bestOut(in);
+  GreedySolver(in, bestOut, bestRng, 1, best[0], best[1], best[2]);
+  log << "Found better solution: " << bestOut.PointProfit() << " with (" << best[0] << ", " << best[1] << ", " << best[2] << ") in " << search.Values().size() << " runs" << std::endl;
+  if(bestOut.PointProfit() > out.PointProfit()) {
+    out = bestOut;
+  }
+}
+
+void GreedyBatch(const std::vector<GreedyJob>& jobs, const std::function<void(std::size_t, const TOP_Output&)>& onDone, int nThreads) {
+  if(nThreads <= 0) {
+    nThreads = max(1U, thread::hardware_concurrency());
+  }
+
+  vector<GreedyArena> arenas(nThreads);
+  std::mutex doneMutex;
+  vector<std::future<void>> results;
+  results.reserve(jobs.size());
+  {
+    ctpl::thread_pool pool(nThreads);
+    for(size_t job = 0; job < jobs.size(); ++job) { // Taken in order, the jobs of an instance go to the same arenas
+      results.push_back(pool.push([&jobs, &onDone, &arenas, &doneMutex, job](int id) {
+        const GreedyJob& j = jobs[job];
+        GreedyArena::Buffers& scratch = arenas[id].Bind(*j.in);
+        TOP_Output& out = *scratch.result;
+        out.Clear();
+        mt19937 jobRng(j.seed);
+        GreedySolver(*j.in, out, jobRng, j.wProfit, j.wTime, j.maxDeviation, j.wNonCost, nullptr, nullptr, j.granularK, &arenas[id]);
+
+        std::lock_guard<std::mutex> lock(doneMutex);
+        onDone(job, out);
+      }));
+    }
+    pool.stop(true);
+  }
+  for(auto& result : results) {
+    result.get(); // Throw the exception of the first job failed
+  }
+}
@@ -2,14 +2,90 @@
 #define SOLVERS_TOP_Greedy_HPP
 
 #include <random>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #include "../common/TOP_Data.hpp"
+#include "../common/ParamSearch.hpp"
 #include "GreedyPaths.hpp"
 
 /***************
  * Declaration *
  ***************/
 
+/**
+ * Limits of an anytime run of the greedy: the run stops at the deadline or when cancel is set (tested at every
+ * step of the solutions) and out holds the best solution found until then, the solution interrupted is a
+ * feasible one too. With a deadline the branches are sampled to fit the remaining time (see
+ * GREEDY_ANYTIME_MINCOUNT_FRACTION) instead of the fixed thresholds of EvaluatePartial.
+ *
+ * Typical usage:
+ *   std::atomic<bool> cancel(false);
+ *   GreedyAnytime anytime = GreedyAnytime::After(2.5);
+ *   anytime.cancel = &cancel;
+ *   anytime.onImprove = [](const TOP_Output& best) { ... };
+ *   GreedySolver(in, out, rng, 1, wTime, maxDev, wNonCost, nullptr, &anytime);
+ */
+struct GreedyAnytime {
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(); // No deadline
+  const std::atomic<bool>* cancel = nullptr; // The run stops when it is set (by another thread)
+  std::function<void(const TOP_Output&)> onImprove; // Called with out after every improvement
+
+  /**
+   * Limits with the deadline after some seconds from now
+   *
+   * @param seconds time allowed to the run (no deadline if not positive)
+   * @return the limits
+   */
+  static GreedyAnytime After(double seconds);
+
+  bool HasDeadline() const { return deadline != std::chrono::steady_clock::time_point::max(); }
+
+  // True when the run must stop (cancelled or deadline passed)
+  bool Expired() const;
+};
+
+/**
+ * Scratch memory of the greedy owned by one thread and reused by its runs: the buffers of the ratings, of the
+ * insertions, the working solution and the tree of the partial solutions keep their capacity, so after the
+ * first run on an instance the steps of the solver do not allocate (only the branches stored by the run do).
+ * The buffers are rebuilt when a run uses another TOP_Input object, Reset must be called when the same object
+ * is loaded again with another instance.
+ *
+ * Typical usage:
+ *   GreedyArena arena;
+ *   for(...) {
+ *     out.Clear();
+ *     GreedySolver(in, out, rng, 1, wTime, maxDev, wNonCost, nullptr, nullptr, 0, &arena);
+ *   }
+ */
+class GreedyArena {
+  public:
+    struct Buffers; // Defined in TOP_Greedy.cpp
+
+    GreedyArena();
+    ~GreedyArena();
+    GreedyArena(const GreedyArena&) = delete;
+    GreedyArena& operator=(const GreedyArena&) = delete;
+
+    /**
+     * Buffers ready for a run on in (rebuilt if they were used with another instance)
+     *
+     * @param in instance of the run
+     * @return the buffers
+     */
+    Buffers& Bind(const TOP_Input& in);
+
+    // Release the buffers of the last instance
+    void Reset();
+
+  private:
+    std::unique_ptr<Buffers> buffers;
+};
+
 /**
  * Solve for one instance, all the partial solution associated and update the best one.
  *
@@ -20,18 +96,110 @@
  * @param wTime weight that multiplies the second (travel time) factor of the rating equation
  * @param maxDeviation max deviation admitted on the path of the car
  * @param wNonCost weight that multiplies the third (no choosing cost or losses) factor of the rating equation
+ * @param nextMaxDeviation if not null it is lowered to the smallest detour above maxDeviation compared in the run,
+ *                         the run (with the same rng) gives the same result for every value in [maxDeviation, *nextMaxDeviation)
+ * @param anytime if not null the limits of the run (deadline, cancellation and improvement callback)
+ * @param granularK if positive (granular neighborhood) each step rates only the granularK nearest neighbors of the
+ *                  last points of the cars (all the points if none of them is feasible) and the insertions in the
+ *                  paths consider only the nearest neighbors of the previous point (see TOP_Input::Neighbors),
+ *                  it is limited to the lists of the instance and ignored by the insertions with nextMaxDeviation
+ * @param arena if not null the scratch memory reused by the run, otherwise it is allocated for the run
+ * @return [void]
+ */
+void GreedySolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, double wProfit, double wTime, double maxDeviation, double wNonCost, double* nextMaxDeviation = nullptr, const GreedyAnytime* anytime = nullptr, idx_t granularK = 0, GreedyArena* arena = nullptr);
+
+// Number of branches queued by GreedyParallelSolver for the whole run (shared by the workers)
+#ifndef GREEDY_PARALLEL_BRANCHES
+#define GREEDY_PARALLEL_BRANCHES 600
+#endif
+
+/**
+ * Same of GreedySolver with the partial solutions explored by a pool of workers: each worker solves the partial
+ * solutions of its own stack (pushing there the new branches) and steals the oldest ones of the other workers when
+ * its stack is empty. The branches are queued until the shared budget is exhausted (instead of EvaluatePartial)
+ * and the best solution is shared. The result depends on the scheduling of the threads (only the run with one
+ * thread is repeatable).
+ *
+ * @param in constant input
+ * @param out constant output
+ * @param rng seed generator, one value is drawn for the generator of each worker
+ * @param wProfit weight that multiplies the first (profit) factor of the rating equation
+ * @param wTime weight that multiplies the second (travel time) factor of the rating equation
+ * @param maxDeviation max deviation admitted on the path of the car
+ * @param wNonCost weight that multiplies the third (no choosing cost or losses) factor of the rating equation
+ * @param nThreads number of workers (0 for the hardware threads)
+ * @param branchBudget number of branches that can be queued in the whole run
+ * @param anytime if not null the limits of the run (deadline, cancellation and improvement callback, called by
+ *                the worker that improves the solution), the branches are still limited by branchBudget
+ * @param granularK if positive the candidates are limited to the nearest neighbors (see GreedySolver)
  * @return [void]
  */
-void GreedySolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, double wProfit, double wTime, double maxDeviation, double wNonCost);
+void GreedyParallelSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, double wProfit, double wTime, double maxDeviation, double wNonCost, int nThreads = 0, long branchBudget = GREEDY_PARALLEL_BRANCHES, const GreedyAnytime* anytime = nullptr, idx_t granularK = 0);
 
 /**
  * Solve for one instance, all the partial solution associated and update the best one using default parameter ranges.
+ * The rows of the grid (wTime, wNonCost) are solved in parallel, each with a seed derived from rng and from its
+ * coordinates, so the result is the same for any number of threads (the first best cell of the sweep).
+ * Inside a row the maxDev values that cannot change the run are skipped (see GREEDY_RANGE_BREAKPOINTS).
  *
  * @param in constant input
  * @param out constant output
- * @param rng seed generator to save the solution and its informations
+ * @param rng seed generator to save the solution and its informations (one value is drawn for the whole sweep)
+ * @param extendedRanges add the extended values of wTime and wNonCost to the grid
+ * @param saveBestParams write the best parameters in the .params file of the instance
+ * @param log stream of the improvements (reported in the sweep order)
+ * @param nThreads number of threads of the pool (0 for the hardware threads)
+ * @return [void]
+ */
+void GreedyRangeSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, bool extendedRanges = true, bool saveBestParams = false, std::ostream& log = std::cout, int nThreads = 0);
+
+/**
+ * Solve for one instance searching the box of the parameters with the adaptive refinement of ParamSearch instead
+ * of a full grid: the regions where the profit does not change are not refined. All the runs use the same seed
+ * (drawn from rng), so the result is the same for any number of threads.
+ *
+ * @param in constant input
+ * @param out constant output, replaced by the best solution found if better
+ * @param rng seed generator (one value is drawn for the whole search)
+ * @param dims ranges of wTime, maxDev and wNonCost (in this order)
+ * @param minDepth depth of the cells always refined
+ * @param maxDepth depth of the finest cells (2^maxDepth steps on every range)
+ * @param log stream of the best solution found
+ * @param nThreads number of threads of the pool (0 for the hardware threads)
+ * @return [void]
+ */
+void GreedyAdaptiveSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, const std::vector<ParamDim>& dims, int minDepth, int maxDepth, std::ostream& log = std::cout, int nThreads = 0);
+
+/**
+ * One run of GreedyBatch: an instance, the parameters of GreedySolver and the seed of its generator
+ */
+struct GreedyJob {
+  const TOP_Input* in; // Alive until GreedyBatch returns
+  double wProfit = 1;
+  double wTime = 0.7;
+  double maxDeviation = 1.5;
+  double wNonCost = 0;
+  std::mt19937::result_type seed = 0;
+  idx_t granularK = 0;
+};
+
+/**
+ * Solve many independent GreedySolver runs (of any instances) on a pool of workers. Every worker owns a
+ * GreedyArena (with the output of its runs), so consecutive jobs of the same instance reuse all the buffers.
+ * Each run has its own generator seeded by its job, so the results do not depend on the number of threads
+ * nor on the scheduling.
+ *
+ * Typical usage:
+ *   std::vector<GreedyJob> jobs;
+ *   for(...) { jobs.push_back({ &in, 1, wTime, maxDev, wNonCost, rng() }); }
+ *   GreedyBatch(jobs, [&](size_t job, const TOP_Output& out) { ... out.PointProfit() ... });
+ *
+ * @param jobs runs to solve
+ * @param onDone called with the index of each job and its solution as soon as it is solved, one call at a time
+ *               (in the order of completion)
+ * @param nThreads number of workers (0 for the hardware threads)
  * @return [void]
  */
-void GreedyRangeSolver(const TOP_Input& in, TOP_Output& out, std::mt19937& rng, bool extendedRanges = true, bool saveBestParams = false, std::ostream& log = std::cout);
+void GreedyBatch(const std::vector<GreedyJob>& jobs, const std::function<void(std::size_t, const TOP_Output&)>& onDone, int nThreads = 0);
 
 #endif
@@ -120,7 +120,7 @@ int TOP_MoveSwap::DeltaCostCar_Swap(const TOP_State& st) const {
 
       // @TODO: Fix better!!!
       if(first.car == second.car) {
-        double timeDelta;
+        dist_t timeDelta;
         if(first.hop + 1 == second.hop) {
           // A -> first -> second -> B to
           // A -> second -> first -> B
@@ -128,10 +128,10 @@ int TOP_MoveSwap::DeltaCostCar_Swap(const TOP_State& st) const {
           // Delete A first and second B
           // Add A second and first B
           timeDelta =
-            + st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(second.car, second.hop))
-            + st.in.Distance(st.Hop(first.car, first.hop), st.Hop(second.car, second.hop + 1))
-            - st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop))
-            - st.in.Distance(st.Hop(second.car, second.hop), st.Hop(second.car, second.hop + 1));
+            + st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(second.car, second.hop))
+            + st.in.Dist(st.Hop(first.car, first.hop), st.Hop(second.car, second.hop + 1))
+            - st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop))
+            - st.in.Dist(st.Hop(second.car, second.hop), st.Hop(second.car, second.hop + 1));
         } else if(first.hop == second.hop + 1) {
           // A -> second -> first -> B to
           // A -> first -> second -> B
@@ -139,62 +139,62 @@ int TOP_MoveSwap::DeltaCostCar_Swap(const TOP_State& st) const {
           // Delete A second and first B
           // Add A first and second B
           timeDelta =
-            - st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(second.car, second.hop))
-            - st.in.Distance(st.Hop(first.car, first.hop), st.Hop(second.car, second.hop + 1))
-            + st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop))
-            + st.in.Distance(st.Hop(second.car, second.hop), st.Hop(second.car, second.hop + 1));
+            - st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(second.car, second.hop))
+            - st.in.Dist(st.Hop(first.car, first.hop), st.Hop(second.car, second.hop + 1))
+            + st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop))
+            + st.in.Dist(st.Hop(second.car, second.hop), st.Hop(second.car, second.hop + 1));
         } else {
           // Same as below but summed
 
           timeDelta =
-            - st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop)) // Remove
-            - st.in.Distance(st.Hop(first.car, first.hop), st.Hop(first.car, first.hop + 1))
-            + st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(second.car, second.hop)) // Insert
-            + st.in.Distance(st.Hop(second.car, second.hop), st.Hop(first.car, first.hop + 1))
-            - st.in.Distance(st.Hop(second.car, second.hop - 1), st.Hop(second.car, second.hop)) // Remove
-            - st.in.Distance(st.Hop(second.car, second.hop), st.Hop(second.car, second.hop + 1))
-            + st.in.Distance(st.Hop(second.car, second.hop - 1), st.Hop(first.car, first.hop)) // Insert
-            + st.in.Distance(st.Hop(first.car, first.hop), st.Hop(second.car, second.hop + 1));
+            - st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop)) // Remove
+            - st.in.Dist(st.Hop(first.car, first.hop), st.Hop(first.car, first.hop + 1))
+            + st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(second.car, second.hop)) // Insert
+            + st.in.Dist(st.Hop(second.car, second.hop), st.Hop(first.car, first.hop + 1))
+            - st.in.Dist(st.Hop(second.car, second.hop - 1), st.Hop(second.car, second.hop)) // Remove
+            - st.in.Dist(st.Hop(second.car, second.hop), st.Hop(second.car, second.hop + 1))
+            + st.in.Dist(st.Hop(second.car, second.hop - 1), st.Hop(first.car, first.hop)) // Insert
+            + st.in.Dist(st.Hop(first.car, first.hop), st.Hop(second.car, second.hop + 1));
         }
         return
-          (st.TravelTime(first.car) > st.in.MaxTime() ? -1 : 0) +
-          (st.TravelTime(first.car) + timeDelta > st.in.MaxTime() ? +1 : 0);
+          (st.TravelDist(first.car) > st.in.MaxDist() ? -1 : 0) +
+          (st.TravelDist(first.car) + timeDelta > st.in.MaxDist() ? +1 : 0);
       }
 
-      double timeDeltaFirst =
-        - st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop)) // Remove
-        - st.in.Distance(st.Hop(first.car, first.hop), st.Hop(first.car, first.hop + 1))
-        + st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(second.car, second.hop)) // Insert
-        + st.in.Distance(st.Hop(second.car, second.hop), st.Hop(first.car, first.hop + 1));
-      double timeDeltaSecond =
-        - st.in.Distance(st.Hop(second.car, second.hop - 1), st.Hop(second.car, second.hop)) // Remove
-        - st.in.Distance(st.Hop(second.car, second.hop), st.Hop(second.car, second.hop + 1))
-        + st.in.Distance(st.Hop(second.car, second.hop - 1), st.Hop(first.car, first.hop)) // Insert
-        + st.in.Distance(st.Hop(first.car, first.hop), st.Hop(second.car, second.hop + 1));
+      dist_t timeDeltaFirst =
+        - st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop)) // Remove
+        - st.in.Dist(st.Hop(first.car, first.hop), st.Hop(first.car, first.hop + 1))
+        + st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(second.car, second.hop)) // Insert
+        + st.in.Dist(st.Hop(second.car, second.hop), st.Hop(first.car, first.hop + 1));
+      dist_t timeDeltaSecond =
+        - st.in.Dist(st.Hop(second.car, second.hop - 1), st.Hop(second.car, second.hop)) // Remove
+        - st.in.Dist(st.Hop(second.car, second.hop), st.Hop(second.car, second.hop + 1))
+        + st.in.Dist(st.Hop(second.car, second.hop - 1), st.Hop(first.car, first.hop)) // Insert
+        + st.in.Dist(st.Hop(first.car, first.hop), st.Hop(second.car, second.hop + 1));
       return
-        (st.TravelTime(first.car) > st.in.MaxTime() ? -1 : 0) +
-        (st.TravelTime(first.car) + timeDeltaFirst > st.in.MaxTime() ? +1 : 0) +
-        (st.TravelTime(second.car) > st.in.MaxTime() ? -1 : 0) +
-        (st.TravelTime(second.car) + timeDeltaSecond > st.in.MaxTime() ? +1 : 0);
+        (st.TravelDist(first.car) > st.in.MaxDist() ? -1 : 0) +
+        (st.TravelDist(first.car) + timeDeltaFirst > st.in.MaxDist() ? +1 : 0) +
+        (st.TravelDist(second.car) > st.in.MaxDist() ? -1 : 0) +
+        (st.TravelDist(second.car) + timeDeltaSecond > st.in.MaxDist() ? +1 : 0);
     } else {
       // Insert
-      double timeDelta =
-        + st.in.Distance(st.Hop(second.car, second.hop - 1), point)
-        + st.in.Distance(point, st.Hop(second.car, second.hop))
-        - st.in.Distance(st.Hop(second.car, second.hop - 1), st.Hop(second.car, second.hop));
+      dist_t timeDelta =
+        + st.in.Dist(st.Hop(second.car, second.hop - 1), point)
+        + st.in.Dist(point, st.Hop(second.car, second.hop))
+        - st.in.Dist(st.Hop(second.car, second.hop - 1), st.Hop(second.car, second.hop));
       return
-        (st.TravelTime(second.car) > st.in.MaxTime() ? -1 : 0) +
-        (st.TravelTime(second.car) + timeDelta > st.in.MaxTime() ? +1 : 0);
+        (st.TravelDist(second.car) > st.in.MaxDist() ? -1 : 0) +
+        (st.TravelDist(second.car) + timeDelta > st.in.MaxDist() ? +1 : 0);
     }
   } else {
     // Remove
-    double timeDelta =
-      - st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop))
-      - st.in.Distance(st.Hop(first.car, first.hop), st.Hop(first.car, first.hop + 1))
-      + st.in.Distance(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop + 1));
+    dist_t timeDelta =
+      - st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop))
+      - st.in.Dist(st.Hop(first.car, first.hop), st.Hop(first.car, first.hop + 1))
+      + st.in.Dist(st.Hop(first.car, first.hop - 1), st.Hop(first.car, first.hop + 1));
     return
-      (st.TravelTime(first.car) > st.in.MaxTime() ? -1 : 0) +
-      (st.TravelTime(first.car) + timeDelta > st.in.MaxTime() ? +1 : 0);
+      (st.TravelDist(first.car) > st.in.MaxDist() ? -1 : 0) +
+      (st.TravelDist(first.car) + timeDelta > st.in.MaxDist() ? +1 : 0);
   }
 
 }
@@ -275,6 +275,52 @@ bool NextInsert(const TOP_State& st, TOP_MoveSwap& m) {
   return true;
 }
 
+/**
+ * Set m.point to the first point not visited in the neighbor list of the hop before m.second, starting from
+ * position start of the list
+ *
+ * @param st current state
+ * @param m insert move with second set
+ * @param k length of the neighbor lists used
+ * @param start first position of the list to test
+ * @return false if there is no such point
+ */
+bool NeighborInsert(const TOP_State& st, TOP_MoveSwap& m, idx_t k, idx_t start) {
+  const idx_t* near = st.in.Neighbors(st.Hop(m.second.car, m.second.hop - 1));
+  for(idx_t i = start; i < k; ++i) {
+    if(near[i] >= 1 && near[i] < st.in.Points() - 1 && !st.Visited(near[i])) {
+      m.point = near[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FirstInsertGranular(const TOP_State& st, TOP_MoveSwap& m, idx_t k) {
+  m.first = { .car = 0, .hop = 0 }; // Unused invalid for insert
+  m.second = { .car = 0, .hop = 0 };
+  while(m.second.Increment(st, true)) { // Position by position
+    if(NeighborInsert(st, m, k, 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool NextInsertGranular(const TOP_State& st, TOP_MoveSwap& m, idx_t k) {
+  const idx_t* near = st.in.Neighbors(st.Hop(m.second.car, m.second.hop - 1));
+  idx_t current = find(near, near + k, m.point) - near;
+  if(NeighborInsert(st, m, k, current + 1)) {
+    return true;
+  }
+  while(m.second.Increment(st, true)) {
+    if(NeighborInsert(st, m, k, 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool FirstRemove(const TOP_State& st, TOP_MoveSwap& m) {
   //std::cout << "FirstRemove" << std::endl;
   m.second = { .car = 0, .hop = 0 }; // Unused
@@ -323,12 +369,21 @@ void TOP_MoveSwapNeighborhoodExplorer::RandomMove(const TOP_State& st, TOP_MoveS
       }
       case 1: {
         // Insert
-        m.point = Random::Uniform<int>(1, st.in.Points() - 2);
-        if(st.Visited(m.point)) {
-          continue;
+        if(granularK > 0) { // One of the nearest neighbors of the previous hop
+          m.second.car = Random::Uniform<int>(0, st.in.Cars() - 1);
+          m.second.hop = Random::Uniform<int>(1, st.Hops(m.second.car));
+          m.point = st.in.Neighbors(st.Hop(m.second.car, m.second.hop - 1))[Random::Uniform<int>(0, granularK - 1)];
+          if(m.point < 1 || m.point >= st.in.Points() - 1 || st.Visited(m.point)) {
+            continue;
+          }
+        } else {
+          m.point = Random::Uniform<int>(1, st.in.Points() - 2);
+          if(st.Visited(m.point)) {
+            continue;
+          }
+          m.second.car = Random::Uniform<int>(0, st.in.Cars() - 1);
+          m.second.hop = Random::Uniform<int>(1, st.Hops(m.second.car));
         }
-        m.second.car = Random::Uniform<int>(0, st.in.Cars() - 1);
-        m.second.hop = Random::Uniform<int>(1, st.Hops(m.second.car));
 
         m.first = { .car = 0, .hop = 0 };
         return;
@@ -393,7 +448,7 @@ void TOP_MoveSwapNeighborhoodExplorer::FirstMove(const TOP_State& st, TOP_MoveSw
   // @TODO: Set m to the first move, always called before NextMove
   // (save order information inside m because this class is immutable/const)
 
-  if(!FirstSwap(st, m) && !FirstInsert(st, m) && !FirstRemove(st, m)) {
+  if(!FirstSwap(st, m) && !FirstInsertMove(st, m) && !FirstRemove(st, m)) {
     throw logic_error("TOP_MoveSwapNeighborhoodExplorer::FirstMove unable to find first move");
   }
 
@@ -410,10 +465,10 @@ bool TOP_MoveSwapNeighborhoodExplorer::NextMove(const TOP_State& st, TOP_MoveSwa
       if(NextSwap(st, m)) {
         return true;
       }
-      return FirstInsert(st, m) || FirstRemove(st, m);
+      return FirstInsertMove(st, m) || FirstRemove(st, m);
     } else {
       // Insert
-      if(NextInsert(st, m)) {
+      if(NextInsertMove(st, m)) {
         return true;
       }
       return FirstRemove(st, m);
@@ -424,3 +479,11 @@ bool TOP_MoveSwapNeighborhoodExplorer::NextMove(const TOP_State& st, TOP_MoveSwa
   }
 
 }
+
+bool TOP_MoveSwapNeighborhoodExplorer::FirstInsertMove(const TOP_State& st, TOP_MoveSwap& m) const {
+  return granularK > 0 ? FirstInsertGranular(st, m, granularK) : FirstInsert(st, m);
+}
+
+bool TOP_MoveSwapNeighborhoodExplorer::NextInsertMove(const TOP_State& st, TOP_MoveSwap& m) const {
+  return granularK > 0 ? NextInsertGranular(st, m, granularK) : NextInsert(st, m);
+}
@@ -100,13 +100,20 @@ class TOP_MoveSwapDeltaCostCar_Swap : public DeltaCostComponent<TOP_Input, TOP_S
 
 // Explorer
 
+/**
+ * Swaps, inserts and removes of the points in the paths. With granularK > 0 (granular neighborhood) a point is
+ * inserted only after one of its granularK nearest neighbors (see TOP_Input::Neighbors): the inserts are
+ * enumerated position by position scanning the neighbor list of the previous hop, so they are O(positions * k)
+ * instead of O(positions * points).
+ */
 class TOP_MoveSwapNeighborhoodExplorer
  : public NeighborhoodExplorer<TOP_Input, TOP_State, TOP_MoveSwap>
 {
   public:
-    TOP_MoveSwapNeighborhoodExplorer(const TOP_Input& pin, StateManager<TOP_Input, TOP_State>& psm, TOP_CostContainer& cc)
+    TOP_MoveSwapNeighborhoodExplorer(const TOP_Input& pin, StateManager<TOP_Input, TOP_State>& psm, TOP_CostContainer& cc, idx_t granularK = 0)
      : NeighborhoodExplorer<TOP_Input, TOP_State, TOP_MoveSwap>(pin, psm, "TOP_MoveNeighborhoodExplorer")
-     , _Car_Swap(in, cc._Car_Swap), _Profit_Swap(in, cc._Profit_Swap) /*, _W_Swap(in, cc._W_Swap)*/ {
+     , _Car_Swap(in, cc._Car_Swap), _Profit_Swap(in, cc._Profit_Swap) /*, _W_Swap(in, cc._W_Swap)*/
+     , granularK(std::min(granularK, pin.NeighborsK())) {
       AddDeltaCostComponent(_Car_Swap);
       AddDeltaCostComponent(_Profit_Swap);
       //AddDeltaCostComponent(_W_Swap);
@@ -120,6 +127,10 @@ class TOP_MoveSwapNeighborhoodExplorer
     TOP_MoveSwapDeltaCostCar_Swap _Car_Swap;
     TOP_MoveSwapDeltaCostProfit_Swap _Profit_Swap;
     // TOP_MoveSwapDeltaCostW_Swap _W_Swap;
+    idx_t granularK; // Length of the candidate lists of the inserts (0 for all the points)
+
+    bool FirstInsertMove(const TOP_State& st, TOP_MoveSwap& m) const;
+    bool NextInsertMove(const TOP_State& st, TOP_MoveSwap& m) const;
 };
 
 #endif
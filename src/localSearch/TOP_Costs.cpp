@@ -17,7 +17,7 @@ int TOP_CostCar_Swap::ComputeCost(const TOP_State& st) const {
   int car_violations = 0;
 
   for(idx_t car = 0; car < st.in.Cars(); ++car) { // Violation in the car travel time
-    if(st.TravelTime(car) > st.in.MaxTime()) {
+    if(st.TravelDist(car) > st.in.MaxDist()) {
       ++car_violations;
     }
   }
@@ -26,7 +26,7 @@ int TOP_CostCar_Swap::ComputeCost(const TOP_State& st) const {
 
 void TOP_CostCar_Swap::PrintViolations(const TOP_State& st, ostream& os) const {
   for(idx_t car = 0; car < st.in.Cars(); ++car) { // Violation in the car travel time
-    if(st.TravelTime(car) > st.in.MaxTime()) {
+    if(st.TravelDist(car) > st.in.MaxDist()) {
       cout << "Car " << car << " has traveled for " << st.TravelTime(car) - st.in.MaxTime() << " out of the MaxTime" << endl;
     }
   }
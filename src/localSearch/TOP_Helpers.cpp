@@ -34,7 +34,7 @@ bool TOP_StateManager::CheckConsistency(const TOP_State& st) const {
   // Insert the code that checks if state in object st is consistent
   // (for debugging purposes)
 	for(idx_t car = 0; car < in.Cars(); ++car) {
-    if(st.TravelTime(car) > in.MaxTime()) {
+    if(st.TravelDist(car) > in.MaxDist()) {
       return false;
     }
   }
@@ -5,6 +5,7 @@
 #include <random>
 #include <nlohmann/json.hpp>
 #include "../common/TOP_Data.hpp"
+#include "../common/ParamSearch.hpp"
 
 namespace Web {
 
@@ -88,6 +89,14 @@ namespace Web {
       };
   };
 
+  /**
+   * Range of a parameter as a dimension of ParamSearch
+   */
+  template<typename T>
+  ParamDim SearchDim(const RParameter<T>& param) {
+    return ParamDim { param.name, (double)param.min, (double)param.max };
+  }
+
 };
 
 class AbstractWebSolver {
@@ -13,10 +13,12 @@ class WebSolverBackTracking : public AbstractWebSolver {
     Web::RParameter<double> maxDev { "maxDev", "Maximum detour distence to capture point", DEF_MAXDEV, 0, 6 };
     Web::RParameter<double> maxTime { "maxTime", "Maximum time allowed", 15, 1, 3*60 };
     Web::RParameter<double> nonGreedyDrop { "nonGreedyDrop", "Drop for non-greedy nodes", 0, 0, 1000 };
+    Web::RParameter<int> granularK { "granularK", "Nearest neighbors of the candidates (0 for all the points)", 0, 0, TOP_NEIGHBORS_K };
+    Web::RParameter<int> threads { "threads", "Threads of the search (0 for all the hardware threads)", 1, 0, 64 };
 
   protected:
     std::vector<Web::Parameter*> GetParameters() override {
-      return { &wTime, &wNonCost, &maxDev, &maxTime, &nonGreedyDrop };
+      return { &wTime, &wNonCost, &maxDev, &maxTime, &nonGreedyDrop, &granularK, &threads };
     }
 
   public:
@@ -27,9 +29,13 @@ class WebSolverBackTracking : public AbstractWebSolver {
     std::string name() override { return "Backtrack"; }
 
     void Solve(const TOP_Input &in, TOP_Output& out, std::mt19937& rng, nlohmann::json& options, std::ostream& log) override {
-      TOP_Walker tw(in, 1, wTime.get(options), maxDev.get(options), wNonCost.get(options), nonGreedyDrop.get(options));
+      TOP_Walker tw(in, 1, wTime.get(options), maxDev.get(options), wNonCost.get(options), nonGreedyDrop.get(options), granularK.get(options));
       TOP_Checker ck;
-      Backtrack(tw, ck, maxTime.get(options));
+      if(threads.get(options) == 1) {
+        Backtrack(tw, ck, maxTime.get(options));
+      } else {
+        ParallelBacktrack(tw, ck, maxTime.get(options), threads.get(options));
+      }
       const auto& best = ck.GetBest(); // Stripping const make a copy necessary
       if(best.HasOutput()) {
         out = best.Output();
@@ -42,10 +48,12 @@ class WebSolverBackTrackingFocus : public AbstractWebSolver {
   private:
     Web::RParameter<double> maxTime { "maxTime", "Maximum time allowed", 15, 1, 3*60 };
     Web::RParameter<double> nonGreedyDrop { "nonGreedyDrop", "Drop for non-greedy nodes", 0, 0, 1000 };
+    Web::RParameter<int> granularK { "granularK", "Nearest neighbors of the candidates (0 for all the points)", 0, 0, TOP_NEIGHBORS_K };
+    Web::RParameter<int> threads { "threads", "Threads of the search (0 for all the hardware threads)", 1, 0, 64 };
 
   protected:
     std::vector<Web::Parameter*> GetParameters() override {
-      return { &maxTime, &nonGreedyDrop };
+      return { &maxTime, &nonGreedyDrop, &granularK, &threads };
     }
 
   public:
@@ -97,9 +105,13 @@ class WebSolverBackTrackingFocus : public AbstractWebSolver {
         }
       }
 
-      TOP_Walker tw(in, 1, wTime, maxDev, wNonCost, nonGreedyDrop.get(options));
+      TOP_Walker tw(in, 1, wTime, maxDev, wNonCost, nonGreedyDrop.get(options), granularK.get(options));
       TOP_Checker ck;
-      Backtrack(tw, ck, maxTime.get(options));
+      if(threads.get(options) == 1) {
+        Backtrack(tw, ck, maxTime.get(options));
+      } else {
+        ParallelBacktrack(tw, ck, maxTime.get(options), threads.get(options));
+      }
       const auto& best = ck.GetBest(); // Stripping const make a copy necessary
       if(best.HasOutput()) {
         out = best.Output();
@@ -10,17 +10,28 @@ class WebSolverGreedy : public AbstractWebSolver {
     Web::RParameter<double> wTime { "wTime", "Weight of Time", 0.7, 0.1, 4 };
     Web::RParameter<double> wNonCost { "wNonCost", "Weight of Missing Costs", 0, 0, 5 };
     Web::RParameter<double> maxDev { "maxDev", "Maximum detour distence to capture point", 1.5, 0, 6 };
+    Web::RParameter<double> maxTime { "maxTime", "Maximum time allowed (0 for no limit)", 0, 0, 3*60 };
+    Web::RParameter<int> granularK { "granularK", "Nearest neighbors of the candidates (0 for all the points)", 0, 0, TOP_NEIGHBORS_K };
 
   protected:
     std::vector<Web::Parameter*> GetParameters() override {
-      return { &wTime, &wNonCost, &maxDev };
+      return { &wTime, &wNonCost, &maxDev, &maxTime, &granularK };
     }
 
   public:
     std::string name() override { return "Greedy Single"; }
 
+    // Ranges of the parameters searched by the adaptive solver (in the order of GreedyAdaptiveSolver)
+    std::vector<ParamDim> SearchDims() const {
+      return { Web::SearchDim(wTime), Web::SearchDim(maxDev), Web::SearchDim(wNonCost) };
+    }
+
     void Solve(const TOP_Input &in, TOP_Output& out, std::mt19937& rng, nlohmann::json& options, std::ostream& log) override {
-      GreedySolver(in, out, rng, 1, wTime.get(options), maxDev.get(options), wNonCost.get(options));
+      GreedyAnytime anytime = GreedyAnytime::After(maxTime.get(options));
+      anytime.onImprove = [&log](const TOP_Output& best) {
+        log << "Found better solution: " << best.PointProfit() << std::endl;
+      };
+      GreedyParallelSolver(in, out, rng, 1, wTime.get(options), maxDev.get(options), wNonCost.get(options), 0, GREEDY_PARALLEL_BRANCHES, &anytime, granularK.get(options));
     }
 
 };
@@ -44,4 +55,23 @@ class WebSolverGreedyRange : public AbstractWebSolver {
 
 };
 
+class WebSolverGreedyAdaptive : public AbstractWebSolver {
+  private:
+    Web::RParameter<int> minDepth { "minDepth", "Depth always refined", 2, 0, 8 };
+    Web::RParameter<int> maxDepth { "maxDepth", "Depth of the finest grid", 4, 1, 10 };
+
+  protected:
+    std::vector<Web::Parameter*> GetParameters() override {
+      return { &minDepth, &maxDepth };
+    }
+
+  public:
+    std::string name() override { return "Greedy Adaptive"; }
+
+    void Solve(const TOP_Input &in, TOP_Output& out, std::mt19937& rng, nlohmann::json& options, std::ostream& log) override {
+      GreedyAdaptiveSolver(in, out, rng, WebSolverGreedy().SearchDims(), minDepth.get(options), maxDepth.get(options), log);
+    }
+
+};
+
 #endif
@@ -8,6 +8,7 @@ namespace fs = std::filesystem;
 #include "../localSearch/TOP_Helpers.hpp"
 #include "../localSearch/TOP_Costs.hpp"
 #include "../localSearch/Moves/Swap.hpp"
+#include "../common/TOP_Binary.hpp"
 
 #include <mutex>
 
@@ -39,11 +40,11 @@ class LocalSolverHelper {
 
   public:
 
-    LocalSolverHelper(const TOP_Input& in, std::string name, std::string solverName) : in(in) {
+    LocalSolverHelper(const TOP_Input& in, std::string name, std::string solverName, idx_t granularK = 0) : in(in) {
       sm = new TOP_StateManager(in);
       cc = new TOP_CostContainer(in); // Create costs
       cc->AddCostComponents(*sm); // Add all cost components
-      nhe = new TOP_MoveSwapNeighborhoodExplorer(in, *sm, *cc); // Create and add delta costs
+      nhe = new TOP_MoveSwapNeighborhoodExplorer(in, *sm, *cc, granularK); // Create and add delta costs
       om = new TOP_OutputManager(in);
   
       _lock.lock();
@@ -76,11 +77,8 @@ class LocalSolverHelper {
 
       TOP_Output out_prec(in);
       {
-        ifstream is("outputs/routeHops/bestRoutes/" + in.name + ".out");
-        if (!is) {
+        if (!LoadOutput("outputs/routeHops/bestRoutes/" + in.name + ".out", out_prec)) {
           log << "<span style='color: red;'>ERROR: Unable to open bestRoutes Instance file, run from empty solution</span>" << endl;
-        } else {
-          is >> out_prec;
         }
       }
       double precProfit = out_prec.PointProfit();
@@ -101,7 +99,7 @@ class LocalSolverHelper {
 // Solvers
 
 void WebSolverLocalSA::Solve(const TOP_Input &in, TOP_Output& out, std::mt19937& rng, nlohmann::json& options, std::ostream& log) {
-  LocalSolverHelper<SimulatedAnnealing<TOP_Input, TOP_State, TOP_MoveSwap>> lsh(in, "TOP_MoveSimulatedAnnealing", "TOP_SA");
+  LocalSolverHelper<SimulatedAnnealing<TOP_Input, TOP_State, TOP_MoveSwap>> lsh(in, "TOP_MoveSimulatedAnnealing", "TOP_SA", granularK.get(options));
 
   LOCAL_SETPARAM(max_evaluations);
   LOCAL_SETPARAM(cooling_rate);
@@ -115,7 +113,7 @@ void WebSolverLocalSA::Solve(const TOP_Input &in, TOP_Output& out, std::mt19937&
 }
 
 void WebSolverLocalHC::Solve(const TOP_Input &in, TOP_Output& out, std::mt19937& rng, nlohmann::json& options, std::ostream& log) {
-  LocalSolverHelper<HillClimbing<TOP_Input, TOP_State, TOP_MoveSwap>> lsh(in, "TOP_MoveHillClimbing", "TOP_HC");
+  LocalSolverHelper<HillClimbing<TOP_Input, TOP_State, TOP_MoveSwap>> lsh(in, "TOP_MoveHillClimbing", "TOP_HC", granularK.get(options));
 
   LOCAL_SETPARAM(max_evaluations);
   LOCAL_SETPARAM(max_idle_iterations);
@@ -124,7 +122,7 @@ void WebSolverLocalHC::Solve(const TOP_Input &in, TOP_Output& out, std::mt19937&
 }
 
 void WebSolverLocalTS::Solve(const TOP_Input &in, TOP_Output& out, std::mt19937& rng, nlohmann::json& options, std::ostream& log) {
-  LocalSolverHelper<TabuSearch<TOP_Input, TOP_State, TOP_MoveSwap>> lsh(in, "TOP_MoveTabuSearch", "TOP_TS");
+  LocalSolverHelper<TabuSearch<TOP_Input, TOP_State, TOP_MoveSwap>> lsh(in, "TOP_MoveTabuSearch", "TOP_TS", granularK.get(options));
 
   LOCAL_SETPARAM(max_evaluations);
   LOCAL_SETPARAM(max_idle_iterations);
@@ -135,7 +133,7 @@ void WebSolverLocalTS::Solve(const TOP_Input &in, TOP_Output& out, std::mt19937&
 }
 
 void WebSolverLocalSD::Solve(const TOP_Input &in, TOP_Output& out, std::mt19937& rng, nlohmann::json& options, std::ostream& log) {
-  LocalSolverHelper<SteepestDescent<TOP_Input, TOP_State, TOP_MoveSwap>> lsh(in, "TOP_MoveSimulatedAnnealing", "TOP_SA");
+  LocalSolverHelper<SteepestDescent<TOP_Input, TOP_State, TOP_MoveSwap>> lsh(in, "TOP_MoveSimulatedAnnealing", "TOP_SA", granularK.get(options));
 
   LOCAL_SETPARAM(max_evaluations);
 
@@ -16,10 +16,11 @@ class WebSolverLocalSA : public AbstractWebSolver {
     Web::RParameter<unsigned int> neighbors_accepted { "neighbors_accepted", "N# Accepted Neighbors", 100000, 0, 10000000 };
     Web::TParameter<bool> compute_start_temperature { "compute_start_temperature", "Compute Starting Temperature", true };
     Web::RParameter<double> start_temperature { "start_temperature", "StartTemperature", 100, 0, 1000 };
+    Web::RParameter<int> granularK { "granularK", "Nearest neighbors of the inserted points (0 for all the points)", 0, 0, TOP_NEIGHBORS_K };
 
   protected:
     std::vector<Web::Parameter*> GetParameters() override {
-      return { &max_evaluations, &cooling_rate, &min_temperature, &neighbors_sampled, &neighbors_accepted, &compute_start_temperature, &start_temperature };
+      return { &max_evaluations, &cooling_rate, &min_temperature, &neighbors_sampled, &neighbors_accepted, &compute_start_temperature, &start_temperature, &granularK };
     }
 
   public:
@@ -32,10 +33,11 @@ class WebSolverLocalHC : public AbstractWebSolver {
   private:
     Web::RParameter<unsigned long int> max_evaluations { "max_evaluations", "Max Evaluations", std::numeric_limits<long int>::max(), 0, std::numeric_limits<long int>::max() };
     Web::RParameter<unsigned long int> max_idle_iterations { "max_idle_iterations", "Max Idle Iterations", 1000000, 0, 100000000 };
+    Web::RParameter<int> granularK { "granularK", "Nearest neighbors of the inserted points (0 for all the points)", 0, 0, TOP_NEIGHBORS_K };
 
   protected:
     std::vector<Web::Parameter*> GetParameters() override {
-      return { &max_evaluations, &max_idle_iterations };
+      return { &max_evaluations, &max_idle_iterations, &granularK };
     }
 
   public:
@@ -50,10 +52,11 @@ class WebSolverLocalTS : public AbstractWebSolver {
     Web::RParameter<unsigned long int> max_idle_iterations { "max_idle_iterations", "Max Idle Iterations", 10000, 0, 100000000 };
     Web::RParameter<unsigned int> max_tenure { "max_tenure", "Maximum steps to remember tabu", 50, 0, 1000 };
     Web::RParameter<unsigned int> min_tenure { "min_tenure", "Minimum steps to remember tabu", 20, 0, 1000 };
+    Web::RParameter<int> granularK { "granularK", "Nearest neighbors of the inserted points (0 for all the points)", 0, 0, TOP_NEIGHBORS_K };
 
   protected:
     std::vector<Web::Parameter*> GetParameters() override {
-      return { &max_evaluations, &max_idle_iterations, &max_tenure, &min_tenure };
+      return { &max_evaluations, &max_idle_iterations, &max_tenure, &min_tenure, &granularK };
     }
 
   public:
@@ -65,10 +68,11 @@ class WebSolverLocalTS : public AbstractWebSolver {
 class WebSolverLocalSD : public AbstractWebSolver {
   private:
     Web::RParameter<unsigned long int> max_evaluations { "max_evaluations", "Max Evaluations", std::numeric_limits<long int>::max(), 0, std::numeric_limits<long int>::max() };
+    Web::RParameter<int> granularK { "granularK", "Nearest neighbors of the inserted points (0 for all the points)", 0, 0, TOP_NEIGHBORS_K };
 
   protected:
     std::vector<Web::Parameter*> GetParameters() override {
-      return { &max_evaluations };
+      return { &max_evaluations, &granularK };
     }
 
   public: